@@ -6,75 +6,1303 @@
 #include <iostream>
 #include <vector>
 #include <cstdio>
+#include <cstring>
+#include <atomic>
+#include <mutex>
+#include <string>
 
 #include "Perf.h"
+#include "PerfStream.h"
+#include "PerfHistogram.h"
+
+#ifndef WINDOWS
+#include <signal.h>
+#include <sys/time.h>
+#include <execinfo.h>
+#include <map>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#endif
+
+#ifdef LINUX
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
 
 using namespace std;
 
 const int MICROS = 1000000;
+const int NANOS = 1000000000;
 
-LARGE_INTEGER frequency;
+PerfTicks frequency; // ticks per second
+PerfTicks scopeOverhead = 0; // ticks that one Perf scope adds to its parent, measured at init
 
 int frame_count = 0;
 
 struct PerformanceData {
-    const char *name;
-    LONGLONG maxTime = 0;
-    LONGLONG totalTime = 0;
-    LONGLONG maxTimeOneFrame = 0;
-    LONGLONG totalTimeThisFrame = 0;
+    PerfTicks maxTime = 0;
+    PerfTicks totalTime = 0;
+    PerfTicks maxTimeOneFrame = 0;
+    PerfTicks totalTimeThisFrame = 0;
+    unsigned int countTotal = 0;
+    unsigned int countThisFrame = 0;
+    Histogram callTimes;
+    Histogram frameTimes; // only frames that the tag ran in
+};
+
+struct ValueData {
+    long long total = 0;
+    long long maxValue = 0;
     unsigned int countTotal = 0;
+    Histogram values;
+};
+
+// only touched by markPerformanceFrame and printPerformanceData
+PerformanceData perf_stats[PERF_MAX_TAGS];
+ValueData value_stats[PERF_MAX_TAGS];
+unsigned long long dropped_events = 0;
+
+// tag names are only ever appended, so indices are stable
+mutex tag_lock;
+const char *tag_names[PERF_MAX_TAGS];
+atomic<int> tag_count(0);
+
+enum PerfCounter {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_L1D_MISSES,
+    COUNTER_LLC_MISSES,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_COUNT
+};
+
+const char *counter_names[COUNTER_COUNT] = { "cycles", "instructions", "L1D read misses", "LLC misses", "branch misses" };
+const int MAX_COUNTER_DEPTH = 64; // scopes nested deeper than this don't read counters
+
+struct CounterData {
+    unsigned long long totals[COUNTER_COUNT] = {};
+    unsigned int samples = 0;
+};
+
+// only touched by the merging thread
+CounterData counter_stats[PERF_MAX_TAGS];
+atomic<bool> counters_enabled(false);
+
+enum PerfEventKind {
+    EVENT_RECORDED, // from recordPerformanceData
+    EVENT_SCOPE, // from a Perf scope
+    EVENT_VALUE // from recordPerformanceValue, endTime is the value
+};
+
+struct PerfEvent {
+    PerfEventKind kind;
+    int tag;
+    int depth; // number of scopes open around this one
+    int node; // in the thread's call tree, or -1 if the tree is full
+    bool hasCounters; // if the counters for this slot of the ring are filled in
+    PerfTicks startTime;
+    PerfTicks endTime;
+};
+
+// A call path, as seen by one thread. The owning thread appends them, and publishes them with nodeCount.
+// tag and parent never change after that, so the merging thread can read them.
+struct ThreadNode {
+    int tag;
+    int parent;
+    int firstChild; // the links are only touched by the owning thread
+    int nextSibling;
 };
 
-vector<PerformanceData> perf_stats;
+// Call paths merged from every thread, with the time spent in them.
+struct CallNode {
+    int tag;
+    int parent;
+    int firstChild;
+    int nextSibling;
+    PerfTicks totalTime = 0; // inclusive
+    PerfTicks childTime = 0; // so exclusive = total - child
+    PerfTicks maxTimeOneFrame = 0;
+    PerfTicks totalTimeThisFrame = 0;
+    unsigned int countTotal = 0;
+};
+
+// only touched by the merging thread
+CallNode call_nodes[PERF_MAX_NODES];
+int call_node_count = 0;
+int call_root_first = -1; // first node with no parent
+
+// Single producer, single consumer ring. The owning thread moves head, markPerformanceFrame moves tail.
+struct ThreadBuffer {
+    PerfEvent events[PERF_EVENTS_PER_THREAD];
+    atomic<unsigned> head;
+    atomic<unsigned> tail;
+    atomic<unsigned> dropped;
+    atomic<bool> retired; // the thread exited, free after the next merge
+    int threadId;
+    int depth; // only touched by the owning thread
+
+    // the scope stack, as a path in this thread's call tree
+    ThreadNode nodes[PERF_MAX_NODES];
+    atomic<int> nodeCount;
+    int rootFirst; // first node with no parent
+    int currentNode; // innermost open scope, or -1
+    int merged[PERF_MAX_NODES]; // call_nodes index for each node, or -1. Only touched by the merging thread.
+
+    // hardware counters, only used once enabled
+    int counterState; // 0 not opened yet, 1 open, -1 unavailable
+    int counterFds[COUNTER_COUNT]; // -1 if that counter couldn't be opened
+    int counterSlots[COUNTER_COUNT]; // where each counter is in a group read
+    int counterGroupSize;
+    unsigned long long counterStarts[MAX_COUNTER_DEPTH][COUNTER_COUNT];
+    bool counterStarted[MAX_COUNTER_DEPTH];
+    // Parallel to events. Allocated when this thread opens its counters, since it's as big again as events.
+    unsigned long long (*counterDeltas)[COUNTER_COUNT];
+
+    ThreadBuffer(int threadId) : head(0), tail(0), dropped(0), retired(false), threadId(threadId), depth(0),
+                                 nodeCount(0), rootFirst(-1), currentNode(-1), counterState(0), counterGroupSize(0),
+                                 counterDeltas(nullptr) {
+        for (int &node : merged) node = -1;
+        for (int &fd : counterFds) fd = -1;
+    }
+
+    ~ThreadBuffer() {
+        delete[] counterDeltas;
+    }
+};
+
+mutex buffer_lock;
+vector<ThreadBuffer *> thread_buffers;
+atomic<int> thread_count(0);
+
+struct TraceEvent {
+    PerfEvent event;
+    int threadId;
+};
+
+// only touched by the merging thread
+bool trace_running = false;
+vector<TraceEvent> trace_events;
+unsigned long long trace_dropped = 0;
+
+// every scope in one frame
+struct FrameCapture {
+    vector<TraceEvent> events;
+    unsigned long long dropped = 0;
+    PerfTicks startTime = 0;
+    PerfTicks duration = 0;
+    int frame = 0; // since the last print
+
+    void clear() {
+        events.clear();
+        dropped = 0;
+    }
+};
+
+const size_t FRAME_CAPTURE_EVENTS = 1 << 14;
+
+// The current frame fills one capture. When it ends, it's swapped with the worst or over budget capture
+// if it deserves keeping, so keeping a frame doesn't allocate.
+FrameCapture frame_captures[3];
+FrameCapture *current_frame = &frame_captures[0];
+FrameCapture *worst_frame = &frame_captures[1]; // since the last print
+FrameCapture *over_budget_frame = &frame_captures[2]; // latest since the last print
+PerfTicks frame_budget = 0; // 0 for none
+PerfTicks last_frame_mark = 0;
+int frames_over_budget = 0;
+
+// registers this thread's buffer on first use, and retires it when the thread exits
+struct ThreadBufferOwner {
+    ThreadBuffer *buffer = nullptr;
+
+    ThreadBuffer *get() {
+        if (!buffer) {
+            buffer = new ThreadBuffer(thread_count.fetch_add(1, memory_order_relaxed));
+            lock_guard<mutex> guard(buffer_lock);
+            thread_buffers.push_back(buffer);
+        }
+        return buffer;
+    }
+
+    ~ThreadBufferOwner();
+};
+
+thread_local ThreadBufferOwner thread_buffer;
+
+// Retired buffers are normally freed by the next merge, which never comes at exit. The main thread's
+// thread_locals are gone before this runs, so its buffer is retired by then. Threads still running keep theirs.
+struct RetiredBufferCleanup {
+    ~RetiredBufferCleanup() {
+        lock_guard<mutex> guard(buffer_lock);
+        for (size_t c = 0; c < thread_buffers.size(); c++) {
+            if (!thread_buffers[c]->retired.load(memory_order_acquire)) continue;
+            delete thread_buffers[c];
+            thread_buffers[c] = thread_buffers.back();
+            thread_buffers.pop_back();
+            c--;
+        }
+    }
+} retired_buffer_cleanup;
+
+#ifdef LINUX
+static int openCounter(unsigned type, unsigned long long config, int group) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = group < 0 ? 1 : 0; // the leader starts the whole group
+    attr.exclude_kernel = 1; // allowed with perf_event_paranoid up to 2
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return int(syscall(__NR_perf_event_open, &attr, 0, -1, group, 0)); // this thread, any cpu
+}
+
+static int perfEventParanoid() {
+    FILE *file = fopen("/proc/sys/kernel/perf_event_paranoid", "r");
+    int level = -100;
+    if (file) {
+        if (fscanf(file, "%d", &level) != 1) level = -100;
+        fclose(file);
+    }
+    return level;
+}
+
+// opens the counter group for this thread, leaving whichever counters the kernel allows
+static void openCounters(ThreadBuffer *buffer) {
+    const unsigned long long l1dReadMiss = PERF_COUNT_HW_CACHE_L1D |
+                                           (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    const unsigned types[COUNTER_COUNT] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE };
+    const unsigned long long configs[COUNTER_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, l1dReadMiss, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+
+    int leader = openCounter(types[COUNTER_CYCLES], configs[COUNTER_CYCLES], -1);
+    if (leader < 0) {
+        int error = errno;
+        buffer->counterState = -1;
+        static atomic<bool> reported(false);
+        if (!reported.exchange(true)) {
+            printf("Hardware counters unavailable (%s, perf_event_paranoid = %d), recording time only\n",
+                   strerror(error), perfEventParanoid());
+        }
+        return;
+    }
+
+    buffer->counterFds[COUNTER_CYCLES] = leader;
+    buffer->counterSlots[COUNTER_CYCLES] = 0;
+    buffer->counterGroupSize = 1;
+    for (int c = COUNTER_CYCLES + 1; c < COUNTER_COUNT; c++) {
+        int fd = openCounter(types[c], configs[c], leader);
+        buffer->counterFds[c] = fd;
+        buffer->counterSlots[c] = fd < 0 ? -1 : buffer->counterGroupSize++;
+        static atomic<bool> reported(false);
+        if (fd < 0 && !reported.exchange(true)) printf("Hardware counter %s unavailable, reporting it as 0\n", counter_names[c]);
+    }
+    // published to the merging thread along with the first event that has counters
+    buffer->counterDeltas = new unsigned long long[PERF_EVENTS_PER_THREAD][COUNTER_COUNT];
+    ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    buffer->counterState = 1;
+}
+
+// reads every counter in the group. False if the group wasn't scheduled on the cpu.
+static bool readCounters(ThreadBuffer *buffer, unsigned long long *values) {
+    unsigned long long data[3 + COUNTER_COUNT]; // nr, time enabled, time running, values
+    ssize_t size = read(buffer->counterFds[COUNTER_CYCLES], data, sizeof(data));
+    if (size < ssize_t(3 * sizeof(data[0])) || data[2] == 0) return false;
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        int slot = buffer->counterSlots[c];
+        values[c] = slot < 0 || unsigned(slot) >= data[0] ? 0 : data[3 + slot];
+    }
+    return true;
+}
+
+static void closeCounters(ThreadBuffer *buffer) {
+    for (int &fd : buffer->counterFds) {
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+}
+#else
+static void openCounters(ThreadBuffer *buffer) {
+    buffer->counterState = -1;
+    static atomic<bool> reported(false);
+    if (!reported.exchange(true)) printf("Hardware counters are only supported on linux, recording time only\n");
+}
+static bool readCounters(ThreadBuffer *buffer, unsigned long long *values) { return false; }
+static void closeCounters(ThreadBuffer *buffer) {}
+#endif
+
+ThreadBufferOwner::~ThreadBufferOwner() {
+    if (buffer) {
+        closeCounters(buffer);
+        buffer->retired.store(true, memory_order_release);
+    }
+    buffer = nullptr;
+}
+
+bool setPerformanceCounters(bool enabled) {
+    counters_enabled.store(enabled, memory_order_relaxed);
+    if (!enabled) return false;
+    ThreadBuffer *buffer = thread_buffer.get(); // try it here, so failures show up right away
+    if (buffer->counterState == 0) openCounters(buffer);
+    return buffer->counterState > 0;
+}
+
+// snapshots the counters for the scope about to open at buffer->depth
+static void startCounters(ThreadBuffer *buffer) {
+    int depth = buffer->depth;
+    if (depth >= MAX_COUNTER_DEPTH) return;
+    buffer->counterStarted[depth] = false;
+    if (!counters_enabled.load(memory_order_relaxed)) return;
+    if (buffer->counterState == 0) openCounters(buffer);
+    if (buffer->counterState < 0) return;
+    buffer->counterStarted[depth] = readCounters(buffer, buffer->counterStarts[depth]);
+}
+
+// fills in the counters for the event about to go in the ring, if the scope has a start snapshot
+static bool stopCounters(ThreadBuffer *buffer, unsigned slot) {
+    int depth = buffer->depth;
+    if (depth >= MAX_COUNTER_DEPTH || !buffer->counterStarted[depth]) return false;
+    unsigned long long now[COUNTER_COUNT];
+    if (!readCounters(buffer, now)) return false;
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        buffer->counterDeltas[slot][c] = now[c] - buffer->counterStarts[depth][c];
+    }
+    return true;
+}
+
+PerfTag::PerfTag(const char *name) {
+    lock_guard<mutex> guard(tag_lock);
+    int count = tag_count.load(memory_order_relaxed);
+    for (int c = 0; c < count; c++) {
+        if (strcmp(tag_names[c], name) == 0) {
+            index = c;
+            return;
+        }
+    }
+    if (count == PERF_MAX_TAGS - 1) {
+        // out of slots, everything else shares the last one
+        tag_names[count] = "(other tags)";
+        tag_count.store(count + 1, memory_order_release);
+    }
+    if (count >= PERF_MAX_TAGS - 1) {
+        index = PERF_MAX_TAGS - 1;
+        return;
+    }
+    tag_names[count] = name;
+    index = count;
+    tag_count.store(count + 1, memory_order_release);
+}
+
+// finds or adds the node for tag under parent in this thread's tree. -1 if the tree is full.
+static int childNode(ThreadBuffer *buffer, int parent, int tag) {
+    int &first = parent < 0 ? buffer->rootFirst : buffer->nodes[parent].firstChild;
+    for (int c = first; c >= 0; c = buffer->nodes[c].nextSibling) {
+        if (buffer->nodes[c].tag == tag) return c;
+    }
+
+    int count = buffer->nodeCount.load(memory_order_relaxed);
+    if (count == PERF_MAX_NODES) return -1;
+    ThreadNode &node = buffer->nodes[count];
+    node.tag = tag;
+    node.parent = parent;
+    node.firstChild = -1;
+    node.nextSibling = first;
+    first = count;
+    buffer->nodeCount.store(count + 1, memory_order_release);
+    return count;
+}
+
+static void pushEvent(ThreadBuffer *buffer, PerfEventKind kind, const PerfTag &tag, int node,
+                      PerfTicks startTime, PerfTicks endTime) {
+    unsigned head = buffer->head.load(memory_order_relaxed);
+    if (head - buffer->tail.load(memory_order_acquire) >= PERF_EVENTS_PER_THREAD) {
+        buffer->dropped.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+    unsigned slot = head & (PERF_EVENTS_PER_THREAD - 1);
+    PerfEvent &event = buffer->events[slot];
+    event.kind = kind;
+    event.tag = tag.index;
+    event.hasCounters = kind == EVENT_SCOPE && stopCounters(buffer, slot);
+    event.depth = buffer->depth;
+    event.node = node;
+    event.startTime = startTime;
+    event.endTime = endTime;
+    buffer->head.store(head + 1, memory_order_release);
+}
+
+void recordPerformanceData(const PerfTag &tag, PerfTicks startTime, PerfTicks endTime) {
+    ThreadBuffer *buffer = thread_buffer.get();
+    int node = buffer->currentNode < 0 && buffer->depth > 0 ? -1 : childNode(buffer, buffer->currentNode, tag.index);
+    pushEvent(buffer, EVENT_RECORDED, tag, node, startTime, endTime);
+}
+
+void recordPerformanceValue(const PerfTag &tag, long long value) {
+    pushEvent(thread_buffer.get(), EVENT_VALUE, tag, -1, 0, value);
+}
+
+// The tags open on this thread, for the SIGPROF handler. Plain thread_locals with no constructor,
+// so the handler can read them without touching anything that could allocate. initial-exec puts them
+// in the static TLS block, so the first read from a thread can't go through __tls_get_addr and allocate,
+// even when collision2d is a shared library.
+#ifdef __GNUC__
+#define PERF_SIGNAL_SAFE_TLS __attribute__((tls_model("initial-exec")))
+#else
+#define PERF_SIGNAL_SAFE_TLS
+#endif
+const int MAX_SAMPLE_DEPTH = 64;
+thread_local int sample_tags[MAX_SAMPLE_DEPTH] PERF_SIGNAL_SAFE_TLS;
+thread_local volatile int sample_depth PERF_SIGNAL_SAFE_TLS = 0;
+
+static inline void pushSampleTag(int tag) {
+    int depth = sample_depth;
+    if (depth < MAX_SAMPLE_DEPTH) sample_tags[depth] = tag;
+    atomic_signal_fence(memory_order_release); // the tag is in place before the handler can see it
+    sample_depth = depth + 1;
+}
+
+static inline void popSampleTag() {
+    sample_depth = sample_depth - 1;
+}
+
+void enterPerformanceSample(const PerfTag &tag) {
+    pushSampleTag(tag.index);
+}
+
+void exitPerformanceSample() {
+    popSampleTag();
+}
+
+int currentPerformanceTag() {
+    int depth = min(int(sample_depth), MAX_SAMPLE_DEPTH);
+    return depth > 0 ? sample_tags[depth - 1] : -1;
+}
+
+const char *performanceTagName(int index) {
+    if (index < 0 || index >= tag_count.load(memory_order_acquire)) return nullptr;
+    return tag_names[index];
+}
+
+void enterPerformanceScope(const PerfTag &tag) {
+    pushSampleTag(tag.index);
+    ThreadBuffer *buffer = thread_buffer.get();
+    // once the tree is full, new paths stay off of it (node -1) until the stack completely unwinds
+    if (buffer->currentNode >= 0 || buffer->depth == 0)
+        buffer->currentNode = childNode(buffer, buffer->currentNode, tag.index);
+    else
+        buffer->currentNode = -1;
+    startCounters(buffer);
+    buffer->depth++;
+}
+
+void exitPerformanceScope(const PerfTag &tag, PerfTicks startTime, PerfTicks endTime) {
+    ThreadBuffer *buffer = thread_buffer.get();
+    buffer->depth--;
+    int node = buffer->currentNode;
+    pushEvent(buffer, EVENT_SCOPE, tag, node, startTime, endTime);
+    if (node >= 0) {
+        buffer->currentNode = buffer->nodes[node].parent;
+    } else if (buffer->depth == 0) {
+        buffer->currentNode = -1;
+    }
+    popSampleTag();
+}
+
+static void recordStat(PerformanceData &data, const PerfTicks timeElapsed) {
+    data.countTotal++;
+    data.countThisFrame++;
+    data.maxTime = max(data.maxTime, timeElapsed);
+    data.totalTimeThisFrame += timeElapsed;
+    data.callTimes.record(timeElapsed);
+}
+
+static void recordValue(ValueData &data, long long value) {
+    data.countTotal++;
+    data.total += value;
+    data.maxValue = data.countTotal == 1 ? value : max(data.maxValue, value);
+    data.values.record(value);
+}
+
+// finds or adds the call_nodes entry for node in buffer's tree
+static int mergedNode(ThreadBuffer *buffer, int node) {
+    if (buffer->merged[node] >= 0) return buffer->merged[node];
+
+    const ThreadNode &threadNode = buffer->nodes[node];
+    int parent = threadNode.parent < 0 ? -1 : mergedNode(buffer, threadNode.parent);
+    if (threadNode.parent >= 0 && parent < 0) return -1;
+
+    int &first = parent < 0 ? call_root_first : call_nodes[parent].firstChild;
+    int found = -1;
+    for (int c = first; c >= 0; c = call_nodes[c].nextSibling) {
+        if (call_nodes[c].tag == threadNode.tag) {
+            found = c;
+            break;
+        }
+    }
+    if (found < 0) {
+        if (call_node_count == PERF_MAX_NODES) return -1;
+        found = call_node_count++;
+        CallNode &call = call_nodes[found];
+        call.tag = threadNode.tag;
+        call.parent = parent;
+        call.firstChild = -1;
+        call.nextSibling = first;
+        first = found;
+    }
+    buffer->merged[node] = found;
+    return found;
+}
+
+static void recordCall(int node, PerfTicks timeElapsed) {
+    CallNode &call = call_nodes[node];
+    call.countTotal++;
+    call.totalTimeThisFrame += timeElapsed;
+    if (call.parent >= 0) call_nodes[call.parent].childTime += timeElapsed;
+}
+
+// pulls every finished event out of the thread buffers and into perf_stats
+static void mergeThreadBuffers() {
+    lock_guard<mutex> guard(buffer_lock);
+    for (size_t c = 0; c < thread_buffers.size(); c++) {
+        ThreadBuffer *buffer = thread_buffers[c];
+        bool retired = buffer->retired.load(memory_order_acquire); // check before draining, so nothing is missed
+        unsigned head = buffer->head.load(memory_order_acquire);
+        unsigned tail = buffer->tail.load(memory_order_relaxed);
+        for (; tail != head; tail++) {
+            const PerfEvent &event = buffer->events[tail & (PERF_EVENTS_PER_THREAD - 1)];
+            if (event.kind == EVENT_VALUE) {
+                recordValue(value_stats[event.tag], event.endTime);
+                continue;
+            }
+            recordStat(perf_stats[event.tag], event.endTime - event.startTime);
+            if (event.hasCounters) {
+                CounterData &counters = counter_stats[event.tag];
+                const unsigned long long *deltas = buffer->counterDeltas[tail & (PERF_EVENTS_PER_THREAD - 1)];
+                for (int c = 0; c < COUNTER_COUNT; c++) counters.totals[c] += deltas[c];
+                counters.samples++;
+            }
+            if (event.node >= 0) {
+                int node = mergedNode(buffer, event.node);
+                if (node >= 0) recordCall(node, event.endTime - event.startTime);
+            }
+            if (current_frame->events.size() < current_frame->events.capacity()) {
+                current_frame->events.push_back({event, buffer->threadId});
+            } else {
+                current_frame->dropped++;
+            }
+            if (trace_running) {
+                if (trace_events.size() < trace_events.capacity()) {
+                    trace_events.push_back({event, buffer->threadId});
+                } else {
+                    trace_dropped++;
+                }
+            }
+        }
+        buffer->tail.store(tail, memory_order_release);
+        dropped_events += buffer->dropped.exchange(0, memory_order_relaxed);
+
+        if (retired) {
+            delete buffer;
+            thread_buffers[c] = thread_buffers.back();
+            thread_buffers.pop_back();
+            c--;
+        }
+    }
+}
+
+static void clearStats() {
+    for (PerformanceData &data : perf_stats) {
+        if (data.countTotal == 0) continue; // nothing to clear, and the histograms are big
+        data.maxTime = 0;
+        data.totalTime = 0;
+        data.maxTimeOneFrame = 0;
+        data.totalTimeThisFrame = 0;
+        data.countTotal = 0;
+        data.countThisFrame = 0;
+        data.callTimes.clear();
+        data.frameTimes.clear();
+    }
+    for (CounterData &counters : counter_stats) {
+        counters = CounterData();
+    }
+    for (ValueData &data : value_stats) {
+        if (data.countTotal == 0) continue;
+        data.total = 0;
+        data.maxValue = 0;
+        data.countTotal = 0;
+        data.values.clear();
+    }
+    for (int c = 0; c < call_node_count; c++) {
+        CallNode &call = call_nodes[c];
+        call.totalTime = 0;
+        call.childTime = 0;
+        call.maxTimeOneFrame = 0;
+        call.totalTimeThisFrame = 0;
+        call.countTotal = 0;
+    }
+    dropped_events = 0;
+    frame_count = 0;
+    worst_frame->clear();
+    worst_frame->duration = 0;
+    over_budget_frame->clear();
+    over_budget_frame->duration = 0;
+    frames_over_budget = 0;
+}
 
 void initPerformanceData() {
-    QueryPerformanceFrequency(&frequency);
-    cout << "Recording performance at " << frequency.QuadPart << " ticks per second" << endl;
+#ifdef WINDOWS
+    LARGE_INTEGER qpf;
+    QueryPerformanceFrequency(&qpf);
+    frequency = qpf.QuadPart;
+#else
+    frequency = NANOS; // CLOCK_MONOTONIC is in nanoseconds
+#endif
+    cout << "Recording performance at " << frequency << " ticks per second" << endl;
+
+    // time a batch of empty scopes to see what the profiler itself costs
+    static PerfTag overheadTag("Perf overhead");
+    const int samples = PERF_EVENTS_PER_THREAD / 2;
+    PerfTicks start = perfTicks();
+    for (int c = 0; c < samples; c++) {
+        Perf stat(overheadTag);
+    }
+    scopeOverhead = (perfTicks() - start) / samples;
+    mergeThreadBuffers();
+    clearStats();
+    cout << "Perf scope overhead is " << scopeOverhead * NANOS / frequency << "nS" << endl;
+}
+
+#ifndef WINDOWS
+const int MAX_SAMPLE_FRAMES = 32;
+const int MAX_STACK_SAMPLES = 1 << 16;
+
+struct StackSample {
+    int tag; // innermost, or -1
+    int frames;
+    void *stack[MAX_SAMPLE_FRAMES];
+};
+
+// written by the handler with lock free atomics only. Index PERF_MAX_TAGS is samples with no tag open.
+atomic<unsigned> sample_self[PERF_MAX_TAGS + 1];
+atomic<unsigned> sample_total[PERF_MAX_TAGS + 1];
+atomic<unsigned> sample_count(0);
+atomic<bool> sample_backtraces(false);
+atomic<unsigned> stack_sample_count(0);
+StackSample *stack_samples = nullptr; // allocated when sampling starts, freed when it stops
+map<string, unsigned> sample_stacks; // collapsed from stack_samples when sampling stops
+bool sampling = false;
+struct sigaction previous_sigprof;
+
+static void sigprofHandler(int signal) {
+    int savedErrno = errno;
+    int depth = sample_depth;
+    atomic_signal_fence(memory_order_acquire);
+    int stored = min(depth, MAX_SAMPLE_DEPTH);
+    int tag = stored > 0 ? sample_tags[stored - 1] : -1;
+
+    sample_count.fetch_add(1, memory_order_relaxed);
+    sample_self[tag < 0 ? PERF_MAX_TAGS : tag].fetch_add(1, memory_order_relaxed);
+    for (int c = 0; c < stored; c++) {
+        // recursion counts once
+        bool seen = false;
+        for (int d = 0; d < c && !seen; d++) seen = sample_tags[d] == sample_tags[c];
+        if (!seen) sample_total[sample_tags[c]].fetch_add(1, memory_order_relaxed);
+    }
+    if (stored == 0) sample_total[PERF_MAX_TAGS].fetch_add(1, memory_order_relaxed);
+
+    if (sample_backtraces.load(memory_order_relaxed)) {
+        unsigned index = stack_sample_count.fetch_add(1, memory_order_relaxed);
+        if (index < MAX_STACK_SAMPLES) {
+            StackSample &sample = stack_samples[index];
+            sample.tag = tag;
+            sample.frames = backtrace(sample.stack, MAX_SAMPLE_FRAMES);
+        }
+    }
+    errno = savedErrno;
+}
+
+static void clearSamples() {
+    for (int c = 0; c <= PERF_MAX_TAGS; c++) {
+        sample_self[c].store(0, memory_order_relaxed);
+        sample_total[c].store(0, memory_order_relaxed);
+    }
+    sample_count.store(0, memory_order_relaxed);
+}
+
+bool startPerformanceSampling(int intervalMicros, bool backtraces) {
+    stopPerformanceSampling();
+    clearSamples();
+
+    if (backtraces) {
+        stack_samples = new StackSample[MAX_STACK_SAMPLES];
+        stack_sample_count.store(0, memory_order_relaxed);
+        sample_stacks.clear();
+        void *warmup[1];
+        backtrace(warmup, 1); // the first call loads libgcc, which isn't safe in a signal handler
+    }
+    sample_backtraces.store(backtraces, memory_order_relaxed);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = sigprofHandler;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, &previous_sigprof) < 0) {
+        printf("Failed to install the SIGPROF handler (%s)\n", strerror(errno));
+        return false;
+    }
+
+    itimerval timer;
+    timer.it_interval.tv_sec = intervalMicros / MICROS;
+    timer.it_interval.tv_usec = intervalMicros % MICROS;
+    timer.it_value = timer.it_interval;
+    if (setitimer(ITIMER_PROF, &timer, nullptr) < 0) {
+        printf("Failed to start the profiling timer (%s)\n", strerror(errno));
+        sigaction(SIGPROF, &previous_sigprof, nullptr);
+        return false;
+    }
+    sampling = true;
+    return true;
+}
+
+// collapses the raw backtraces into sample_stacks, outermost frame first with the active tag at the root
+static void collapseStackSamples() {
+    unsigned samples = min(stack_sample_count.load(memory_order_acquire), unsigned(MAX_STACK_SAMPLES));
+    for (unsigned c = 0; c < samples; c++) {
+        const StackSample &sample = stack_samples[c];
+        string line = sample.tag < 0 ? "(no tag)" : tag_names[sample.tag];
+        char **symbols = backtrace_symbols(sample.stack, sample.frames);
+        for (int frame = sample.frames - 1; frame >= 1; frame--) { // frame 0 is the handler
+            line += ';';
+            line += symbols ? symbols[frame] : "?";
+        }
+        free(symbols);
+        sample_stacks[line]++;
+    }
+}
+
+void stopPerformanceSampling() {
+    if (!sampling) return;
+    itimerval timer;
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    sigaction(SIGPROF, &previous_sigprof, nullptr);
+    sample_backtraces.store(false, memory_order_relaxed);
+    sampling = false;
+
+    if (stack_samples) {
+        collapseStackSamples();
+        delete[] stack_samples;
+        stack_samples = nullptr;
+    }
+}
+
+// stops the timer before anything it writes to is destroyed, if the program exits while sampling
+struct SamplingCleanup {
+    ~SamplingCleanup() {
+        stopPerformanceSampling();
+    }
+} sampling_cleanup;
+
+static void printSamples() {
+    unsigned total = sample_count.load(memory_order_relaxed);
+    if (total == 0) return;
+    printf("Sampled %u times\n", total);
+    printf("  SELF%%  TOTAL%%  TAG\n");
+    int count = tag_count.load(memory_order_acquire);
+    for (int c = 0; c <= count; c++) {
+        int index = c == count ? PERF_MAX_TAGS : c;
+        unsigned self = sample_self[index].load(memory_order_relaxed);
+        unsigned inclusive = sample_total[index].load(memory_order_relaxed);
+        if (self == 0 && inclusive == 0) continue;
+        printf("%6.2f%%  %5.2f%%  %s\n", 100.0 * self / total, 100.0 * inclusive / total,
+               c == count ? "(no tag)" : tag_names[c]);
+    }
+    clearSamples();
+}
+
+bool writePerformanceSamples(const char *filename) {
+    stopPerformanceSampling(); // the backtraces are collapsed when sampling stops
+    if (sample_stacks.empty()) {
+        printf("No stack samples to write, start sampling with backtraces first\n");
+        return false;
+    }
+    FILE *file = fopen(filename, "w");
+    if (!file) {
+        printf("Failed to open %s for the stack samples\n", filename);
+        return false;
+    }
+
+    unsigned samples = 0;
+    for (const auto &stack : sample_stacks) {
+        fprintf(file, "%s %u\n", stack.first.c_str(), stack.second);
+        samples += stack.second;
+    }
+    fclose(file);
+    printf("Wrote %u stack samples to %s\n", samples, filename);
+    return true;
+}
+#else
+bool startPerformanceSampling(int intervalMicros, bool backtraces) {
+    printf("Sampling is not supported on windows yet\n");
+    return false;
+}
+void stopPerformanceSampling() {}
+static void printSamples() {}
+bool writePerformanceSamples(const char *filename) { return false; }
+#endif
+
+void setPerformanceFrameBudget(double milliseconds) {
+    frame_budget = PerfTicks(milliseconds * frequency / 1000);
+}
+
+// keeps the frame that just ended if it's the worst so far or over budget
+static void captureFrame(PerfTicks now) {
+    if (current_frame->events.capacity() == 0) {
+        for (FrameCapture &capture : frame_captures) capture.events.reserve(FRAME_CAPTURE_EVENTS);
+    }
+
+    if (last_frame_mark != 0) {
+        current_frame->startTime = last_frame_mark;
+        current_frame->duration = now - last_frame_mark;
+        current_frame->frame = frame_count;
+        if (frame_budget > 0 && current_frame->duration > frame_budget) {
+            frames_over_budget++;
+            swap(current_frame, over_budget_frame);
+            // the worst frame is usually over budget too, so make sure it's still kept
+            if (over_budget_frame->duration > worst_frame->duration) {
+                worst_frame->events = over_budget_frame->events;
+                worst_frame->dropped = over_budget_frame->dropped;
+                worst_frame->startTime = over_budget_frame->startTime;
+                worst_frame->duration = over_budget_frame->duration;
+                worst_frame->frame = over_budget_frame->frame;
+            }
+        } else if (current_frame->duration > worst_frame->duration) {
+            swap(current_frame, worst_frame);
+        }
+    }
+    current_frame->clear();
+    last_frame_mark = now;
+}
+
+static void printFrameCapture(const char *title, const FrameCapture &capture) {
+    printf("%s: %.3fmS, frame %d of this report", title, double(capture.duration) * 1000 / frequency, capture.frame);
+    if (capture.dropped) printf(", %llu scopes not captured", capture.dropped);
+    printf("\n");
+
+    // total up each tag for the frame
+    PerfTicks totals[PERF_MAX_TAGS] = {};
+    unsigned counts[PERF_MAX_TAGS] = {};
+    for (const TraceEvent &trace : capture.events) {
+        totals[trace.event.tag] += trace.event.endTime - trace.event.startTime;
+        counts[trace.event.tag]++;
+    }
+    int count = tag_count.load(memory_order_acquire);
+    for (int c = 0; c < count; c++) {
+        if (counts[c] == 0) continue;
+        printf("  %9.1fuS  %6u calls  %s\n", double(totals[c]) * MICROS / frequency, counts[c], tag_names[c]);
+    }
+}
+
+static void printCallTree(int first, int depth) {
+    for (int c = first; c >= 0; c = call_nodes[c].nextSibling) {
+        const CallNode &call = call_nodes[c];
+        if (call.countTotal == 0) continue;
+        printf("%9.1fuS  %9.1fuS  %9.1fuS  %11.4f  %*s%s\n",
+               double(call.totalTime) * MICROS / frame_count / frequency,
+               double(call.totalTime - call.childTime) * MICROS / frame_count / frequency,
+               double(call.maxTimeOneFrame) * MICROS / frequency,
+               float(call.countTotal) / frame_count,
+               depth * 2, "",
+               tag_names[call.tag]);
+        printCallTree(call.firstChild, depth + 1);
+    }
 }
 
 void printPerformanceData() {
-    printf("Performance - last %d frames\n", frame_count);
+    if (frame_count == 0) {
+        // every per frame number divides by it, so wait for a frame. Anything recorded so far keeps.
+        printf("Performance - no frames marked since the last report\n");
+        return;
+    }
+    printf("Performance - last %d frames, %lldnS overhead per scope\n", frame_count, scopeOverhead * NANOS / frequency);
+    if (dropped_events) printf("Dropped %llu scopes, thread buffers were full\n", dropped_events);
     printf("AVG_STAT  MAX_STAT  PER_FRAME  AVG_FRAME  MAX_FRAME  TAG\n");
-    for (const PerformanceData &data : perf_stats) {
+    int count = tag_count.load(memory_order_acquire);
+    for (int c = 0; c < count; c++) {
+        const PerformanceData &data = perf_stats[c];
+        if (data.countTotal == 0) continue;
         printf("%6llduS  %6llduS  %9.4f  %7llduS  %7llduS  %s\n",
-               data.totalTime * MICROS / data.countTotal / frequency.QuadPart,
-               data.maxTime * MICROS / frequency.QuadPart,
+               data.totalTime * MICROS / data.countTotal / frequency,
+               data.maxTime * MICROS / frequency,
                float(data.countTotal) / frame_count,
-               data.totalTime * MICROS / frame_count / frequency.QuadPart,
-               data.maxTimeOneFrame * MICROS / frequency.QuadPart,
-               data.name);
+               data.totalTime * MICROS / frame_count / frequency,
+               data.maxTimeOneFrame * MICROS / frequency,
+               tag_names[c]);
     }
 
-    frame_count = 0;
-    perf_stats.clear();
+    // percentiles from the histograms, per call and then per frame the tag ran in
+    printf("P50_STAT  P90_STAT  P99_STAT  P999_STAT  P50_FRAME  P90_FRAME  P99_FRAME  P999_FRAME  TAG\n");
+    for (int c = 0; c < count; c++) {
+        const PerformanceData &data = perf_stats[c];
+        if (data.countTotal == 0) continue;
+        printf("%6.1fuS  %6.1fuS  %6.1fuS  %7.1fuS  %7.1fuS  %7.1fuS  %7.1fuS  %8.1fuS  %s\n",
+               data.callTimes.percentile(50) * MICROS / frequency,
+               data.callTimes.percentile(90) * MICROS / frequency,
+               data.callTimes.percentile(99) * MICROS / frequency,
+               data.callTimes.percentile(99.9) * MICROS / frequency,
+               data.frameTimes.percentile(50) * MICROS / frequency,
+               data.frameTimes.percentile(90) * MICROS / frequency,
+               data.frameTimes.percentile(99) * MICROS / frequency,
+               data.frameTimes.percentile(99.9) * MICROS / frequency,
+               tag_names[c]);
+    }
+
+    // distributions of recorded values, like iteration counts
+    bool anyValues = false;
+    for (int c = 0; c < count; c++) {
+        const ValueData &data = value_stats[c];
+        if (data.countTotal == 0) continue;
+        if (!anyValues) {
+            printf("    COUNT  PER_FRAME      AVG    P50    P90    P99     MAX  VALUE\n");
+            anyValues = true;
+        }
+        printf("%9u  %9.4f  %7.2f  %5.0f  %5.0f  %5.0f  %6lld  %s\n",
+               data.countTotal,
+               float(data.countTotal) / frame_count,
+               double(data.total) / data.countTotal,
+               data.values.percentile(50),
+               data.values.percentile(90),
+               data.values.percentile(99),
+               data.maxValue,
+               tag_names[c]);
+    }
+
+    // hardware counters per call, for the scopes that read them
+    bool anyCounters = false;
+    for (int c = 0; c < count; c++) {
+        const CounterData &counters = counter_stats[c];
+        if (counters.samples == 0) continue;
+        if (!anyCounters) {
+            printf("SAMPLES   CYC_CALL  INST_CALL    IPC  L1D_MISS  LLC_MISS  BR_MISS  TAG\n");
+            anyCounters = true;
+        }
+        double calls = counters.samples;
+        printf("%7u  %9.0f  %9.0f  %5.2f  %8.1f  %8.1f  %7.1f  %s\n",
+               counters.samples,
+               counters.totals[COUNTER_CYCLES] / calls,
+               counters.totals[COUNTER_INSTRUCTIONS] / calls,
+               counters.totals[COUNTER_CYCLES] ? double(counters.totals[COUNTER_INSTRUCTIONS]) / counters.totals[COUNTER_CYCLES] : 0.0,
+               counters.totals[COUNTER_L1D_MISSES] / calls,
+               counters.totals[COUNTER_LLC_MISSES] / calls,
+               counters.totals[COUNTER_BRANCH_MISSES] / calls,
+               tag_names[c]);
+    }
+
+    // what was going on in the frames worth a closer look
+    if (worst_frame->duration > 0) printFrameCapture("Worst frame", *worst_frame);
+    if (frames_over_budget > 0) {
+        printf("%d frames over the %.3fmS budget. ", frames_over_budget, double(frame_budget) * 1000 / frequency);
+        printFrameCapture("Latest", *over_budget_frame);
+    }
+
+    // which tags the SIGPROF samples landed in
+    printSamples();
+
+    // the same scopes, split up by where they were called from
+    printf(" INCL_FRAME   EXCL_FRAME    MAX_FRAME  CALLS_FRAME  TREE\n");
+    printCallTree(call_root_first, 0);
+
+    clearStats();
 }
 
-static void recordStat(PerformanceData &data, const LONGLONG timeElapsed) {
-    data.countTotal++;
-    data.maxTime = max(data.maxTime, timeElapsed);
-    data.totalTimeThisFrame += timeElapsed;
+#ifndef WINDOWS
+struct StreamClient {
+    int fd = -1;
+    int namesSent = 0; // tags this client has names for
+    unsigned long long dropped = 0;
+};
+
+const int MAX_STREAM_CLIENTS = 4;
+
+// only touched by the merging thread
+int stream_fd = -1;
+string stream_path;
+StreamClient stream_clients[MAX_STREAM_CLIENTS];
+unsigned long long stream_frame = 0;
+char stream_packet[PERF_STREAM_MAX_PACKET];
+
+bool startPerformanceStream(const char *path) {
+    stopPerformanceStream();
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        printf("Performance stream path %s is too long\n", path);
+        return false;
+    }
+    strcpy(address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (fd < 0) {
+        printf("Failed to create the performance stream socket (%s)\n", strerror(errno));
+        return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    unlink(path); // left over from a previous run
+    if (bind(fd, (sockaddr *) &address, sizeof(address)) < 0 || listen(fd, MAX_STREAM_CLIENTS) < 0) {
+        printf("Failed to listen on %s for the performance stream (%s)\n", path, strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    stream_fd = fd;
+    stream_path = path;
+    printf("Streaming performance data on %s\n", path);
+    return true;
 }
 
-void recordPerformanceData(const char *name, const LONGLONG timeElapsed) {
-    for (PerformanceData &data : perf_stats) {
-        if (data.name == name) { // using == because it's faster and you shouldn't be using the same key multiple times.
-            recordStat(data, timeElapsed);
-            return;
+void stopPerformanceStream() {
+    if (stream_fd < 0) return;
+    for (StreamClient &client : stream_clients) {
+        if (client.fd >= 0) close(client.fd);
+        client = StreamClient();
+    }
+    close(stream_fd);
+    unlink(stream_path.c_str());
+    stream_fd = -1;
+}
+
+bool isPerformanceStreamRunning() {
+    return stream_fd >= 0;
+}
+
+// false if the client is gone. A full socket just drops the packet.
+static bool sendPacket(StreamClient &client, size_t size, bool &sent) {
+    sent = send(client.fd, stream_packet, size, MSG_DONTWAIT | MSG_NOSIGNAL) == ssize_t(size);
+    if (sent || errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) return true;
+    close(client.fd);
+    client = StreamClient();
+    return false;
+}
+
+static void sendNames(StreamClient &client, int count) {
+    while (client.namesSent < count) {
+        PerfStreamHeader *header = (PerfStreamHeader *) stream_packet;
+        header->magic = PERF_STREAM_MAGIC;
+        header->type = PERF_STREAM_NAMES;
+        header->count = 0;
+        size_t size = sizeof(PerfStreamHeader);
+        int tag = client.namesSent;
+        for (; tag < count; tag++) {
+            size_t length = min(strlen(tag_names[tag]), size_t(PERF_STREAM_MAX_NAME));
+            if (size + sizeof(PerfStreamName) + length > sizeof(stream_packet)) break;
+            PerfStreamName name = { uint16_t(tag), uint16_t(length) };
+            memcpy(stream_packet + size, &name, sizeof(name));
+            memcpy(stream_packet + size + sizeof(name), tag_names[tag], length);
+            size += sizeof(name) + length;
+            header->count++;
+        }
+        bool sent;
+        if (!sendPacket(client, size, sent) || !sent) return;
+        client.namesSent = tag;
+    }
+}
+
+// sends what each tag did this frame to every client, before the frame totals are cleared
+static void streamFrame(PerfTicks duration) {
+    if (stream_fd < 0) return;
+
+    for (int fd; (fd = accept(stream_fd, nullptr, nullptr)) >= 0;) {
+        bool placed = false;
+        for (StreamClient &client : stream_clients) {
+            if (client.fd < 0) {
+                client.fd = fd;
+                placed = true;
+                break;
+            }
+        }
+        if (!placed) close(fd); // full up
+    }
+
+    int count = tag_count.load(memory_order_acquire);
+    for (StreamClient &client : stream_clients) {
+        if (client.fd < 0) continue;
+        sendNames(client, count);
+        if (client.fd < 0 || client.namesSent < count) {
+            if (client.fd >= 0) client.dropped++;
+            continue;
+        }
+
+        PerfStreamHeader *header = (PerfStreamHeader *) stream_packet;
+        header->magic = PERF_STREAM_MAGIC;
+        header->type = PERF_STREAM_FRAME;
+        header->count = 0;
+        PerfStreamFrame frame = { stream_frame, duration, frequency, client.dropped };
+        memcpy(stream_packet + sizeof(PerfStreamHeader), &frame, sizeof(frame));
+        size_t size = sizeof(PerfStreamHeader) + sizeof(PerfStreamFrame);
+        for (int c = 0; c < count; c++) {
+            const PerformanceData &data = perf_stats[c];
+            if (data.countThisFrame == 0) continue;
+            PerfStreamTag tag = { uint16_t(c), 0, data.countThisFrame, data.totalTimeThisFrame };
+            memcpy(stream_packet + size, &tag, sizeof(tag));
+            size += sizeof(tag);
+            header->count++;
+        }
+
+        bool sent;
+        if (sendPacket(client, size, sent)) {
+            if (sent) client.dropped = 0;
+            else client.dropped++;
         }
     }
-    perf_stats.emplace_back();
-    perf_stats.back().name = name;
-    recordStat(perf_stats.back(), timeElapsed);
+    stream_frame++;
+}
+#else
+bool startPerformanceStream(const char *path) {
+    printf("Performance streaming is not supported on windows yet\n");
+    return false;
 }
+void stopPerformanceStream() {}
+bool isPerformanceStreamRunning() { return false; }
+static void streamFrame(PerfTicks duration) {}
+#endif
 
 void markPerformanceFrame() {
+    mergeThreadBuffers();
+    PerfTicks now = perfTicks();
+    streamFrame(last_frame_mark ? now - last_frame_mark : 0);
+    captureFrame(now);
     for (PerformanceData &data : perf_stats) {
+        if (data.countThisFrame) data.frameTimes.record(data.totalTimeThisFrame);
         data.maxTimeOneFrame = max(data.maxTimeOneFrame, data.totalTimeThisFrame);
         data.totalTime += data.totalTimeThisFrame;
         data.totalTimeThisFrame = 0;
+        data.countThisFrame = 0;
+    }
+    for (int c = 0; c < call_node_count; c++) {
+        CallNode &call = call_nodes[c];
+        call.maxTimeOneFrame = max(call.maxTimeOneFrame, call.totalTimeThisFrame);
+        call.totalTime += call.totalTimeThisFrame;
+        call.totalTimeThisFrame = 0;
     }
     frame_count++;
 }
 
+static void writeCallStack(FILE *file, int node) {
+    if (call_nodes[node].parent >= 0) {
+        writeCallStack(file, call_nodes[node].parent);
+        fputc(';', file);
+    }
+    for (const char *name = tag_names[call_nodes[node].tag]; *name; name++) {
+        fputc(*name == ';' ? ':' : *name, file); // ; separates frames
+    }
+}
+
+bool writePerformanceCollapsedStacks(const char *filename) {
+    FILE *file = fopen(filename, "w");
+    if (!file) {
+        printf("Failed to open %s for the collapsed stacks\n", filename);
+        return false;
+    }
+
+    // one line per path, weighted by exclusive microseconds since the last print
+    for (int c = 0; c < call_node_count; c++) {
+        const CallNode &call = call_nodes[c];
+        long long self = (call.totalTime - call.childTime) * MICROS / frequency;
+        if (call.countTotal == 0 || self <= 0) continue;
+        writeCallStack(file, c);
+        fprintf(file, " %lld\n", self);
+    }
+    fclose(file);
+    printf("Wrote collapsed stacks to %s\n", filename);
+    return true;
+}
+
+void startPerformanceTrace(size_t maxEvents) {
+    trace_events.clear();
+    trace_events.reserve(maxEvents);
+    trace_dropped = 0;
+    trace_running = true;
+}
+
+bool isPerformanceTraceRunning() {
+    return trace_running;
+}
+
+static void writeJsonString(FILE *file, const char *str) {
+    fputc('"', file);
+    for (; *str; str++) {
+        if (*str == '"' || *str == '\\') fputc('\\', file);
+        if ((unsigned char) *str < 0x20) {
+            fprintf(file, "\\u%04x", *str);
+        } else {
+            fputc(*str, file);
+        }
+    }
+    fputc('"', file);
+}
+
+static bool writeTraceJson(const char *filename, const vector<TraceEvent> &events) {
+    FILE *file = fopen(filename, "w");
+    if (!file) {
+        printf("Failed to open %s for the performance trace\n", filename);
+        return false;
+    }
+
+    PerfTicks origin = 0;
+    for (size_t c = 0; c < events.size(); c++) {
+        if (c == 0 || events[c].event.startTime < origin) origin = events[c].event.startTime;
+    }
+
+    // complete ("X") events, which viewers nest by time within each thread
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (const TraceEvent &trace : events) {
+        fprintf(file, "{\"name\":");
+        writeJsonString(file, tag_names[trace.event.tag]);
+        fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"depth\":%d}},\n",
+                trace.threadId,
+                double(trace.event.startTime - origin) * MICROS / frequency,
+                double(trace.event.endTime - trace.event.startTime) * MICROS / frequency,
+                trace.event.depth);
+    }
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Collision2D\"}}\n]}\n");
+    fclose(file);
+    return true;
+}
+
+bool writeWorstFrameTrace(const char *filename) {
+    if (worst_frame->duration == 0) {
+        printf("No worst frame to write yet\n");
+        return false;
+    }
+    if (!writeTraceJson(filename, worst_frame->events)) return false;
+    printf("Wrote the worst frame (%.3fmS) to %s\n", double(worst_frame->duration) * 1000 / frequency, filename);
+    return true;
+}
+
+bool writePerformanceTrace(const char *filename) {
+    // Doesn't merge the thread buffers, since that would count half a frame into the stats.
+    // Scopes since the last markPerformanceFrame are left for the next frame, and aren't traced.
+    trace_running = false;
+
+    if (!writeTraceJson(filename, trace_events)) return false;
+
+    printf("Wrote %zu scopes to %s", trace_events.size(), filename);
+    if (trace_dropped) printf(", dropped %llu after the buffer filled", trace_dropped);
+    printf("\n");
+
+    trace_events.clear();
+    trace_events.shrink_to_fit();
+    return true;
+}
+
 #endif // PERF
@@ -5,43 +5,168 @@
 #ifndef COLLISION2D_PERF_H
 #define COLLISION2D_PERF_H
 
+#include <cstddef>
+
 #ifdef PERF
 
+#ifdef WINDOWS
 #include <afxres.h>
+#else
+#include <time.h>
+#endif
+
+typedef long long PerfTicks;
+
+const int PERF_MAX_TAGS = 256;
+const int PERF_MAX_NODES = 1024; // distinct call paths per thread, and in total
+const unsigned PERF_EVENTS_PER_THREAD = 1 << 14; // must be a power of two. Scopes past this in one frame are dropped.
+
+// the current time, in ticks of the clock that initPerformanceData reports
+static inline PerfTicks perfTicks() {
+#ifdef WINDOWS
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return now.QuadPart;
+#else
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+#endif
+}
+
+// A name resolved to a stat slot once, so recording never searches.
+// Make these static, either globally or in the function that uses them.
+// Tags with the same name share a slot.
+struct PerfTag {
+    int index;
+    explicit PerfTag(const char *name);
+};
 
 void initPerformanceData();
+// prints everything since the last report, then starts a new one. Waits until a frame has been marked.
 void printPerformanceData();
-void recordPerformanceData(const char *name, const LONGLONG timeElapsed);
+// safe to call from any thread. Goes into a buffer for that thread until the next markPerformanceFrame.
+// Recorded as nested inside whatever Perf scope is open on this thread.
+void recordPerformanceData(const PerfTag &tag, PerfTicks startTime, PerfTicks endTime);
+// records a number instead of a time, like an iteration count. Reported as a distribution per tag.
+// Values are bucketed like times, so counts under 64 are exact.
+void recordPerformanceValue(const PerfTag &tag, long long value);
+// merges every thread's buffer into the stats. Call from one thread only.
 void markPerformanceFrame();
 
+// Linux only. While enabled, Perf scopes also read cycles, instructions, cache and branch misses from perf_event_open.
+// Each thread opens its counters on its first scope after this. Returns false if this thread can't get them
+// (no PMU in a vm, or perf_event_paranoid too high), in which case timing carries on without them.
+bool setPerformanceCounters(bool enabled);
+
+// Writes the call tree since the last print in collapsed stack format ("a;b;c microseconds"),
+// for flamegraph.pl, speedscope and the like.
+bool writePerformanceCollapsedStacks(const char *filename);
+
+// Frames longer than this keep their scopes for the next report, like the worst frame does. 0 turns it off.
+// Call after initPerformanceData.
+void setPerformanceFrameBudget(double milliseconds);
+// Writes every scope of the worst frame since the last report, in the same format as writePerformanceTrace.
+bool writeWorstFrameTrace(const char *filename);
+
+// Sends a summary of every frame to up to 4 clients on a unix domain socket at path, see PerfStream.h and perfview.
+// Never blocks: frames are dropped while nobody is connected, or when a client falls behind.
+bool startPerformanceStream(const char *path);
+void stopPerformanceStream();
+bool isPerformanceStreamRunning();
+
+// Every intervalMicros of cpu time, a SIGPROF handler notes which tag is innermost on the interrupted thread,
+// and optionally its backtrace. Reported as the fraction of samples per tag, with no scope overhead beyond
+// keeping track of the open tags. Not on windows.
+bool startPerformanceSampling(int intervalMicros, bool backtraces);
+// symbolizes the backtraces and frees the buffer they were caught in
+void stopPerformanceSampling();
+// Writes the backtraces as collapsed stacks ("tag;outer;...;inner count"), symbolized with backtrace_symbols.
+// Stops sampling first if it's still running.
+bool writePerformanceSamples(const char *filename);
+
+// The innermost tag open on this thread, or -1. Only reads plain thread_locals, so it's safe anywhere,
+// even inside a replaced operator new.
+int currentPerformanceTag();
+// the name a tag index was made with, or nullptr
+const char *performanceTagName(int index);
+
+// used by PerfSample
+void enterPerformanceSample(const PerfTag &tag);
+void exitPerformanceSample();
+
+// Marks tag as active for sampling, without timing anything. Cheap enough for hot loops.
+class PerfSample {
+public:
+    PerfSample(const PerfTag &tag) { enterPerformanceSample(tag); }
+    ~PerfSample() { exitPerformanceSample(); }
+};
+
+// Keeps every scope, up to maxEvents, until writePerformanceTrace. The buffer is allocated here, never while recording.
+void startPerformanceTrace(size_t maxEvents);
+bool isPerformanceTraceRunning();
+// Writes the captured scopes as Chrome trace event json (chrome://tracing or ui.perfetto.dev) and stops capturing.
+// Only has the scopes up to the last markPerformanceFrame.
+bool writePerformanceTrace(const char *filename);
+
+// used by Perf to track nesting on this thread
+void enterPerformanceScope(const PerfTag &tag);
+void exitPerformanceScope(const PerfTag &tag, PerfTicks startTime, PerfTicks endTime);
+
 class Perf {
 private:
-    const char * const name;
-    LARGE_INTEGER startTime;
+    const PerfTag &tag;
+    PerfTicks startTime;
 
 public:
-    Perf(const char *name) :
-            name(name)
+    Perf(const PerfTag &tag) :
+            tag(tag)
     {
-        QueryPerformanceCounter(&startTime);
+        enterPerformanceScope(tag);
+        startTime = perfTicks();
     }
 
     ~Perf() {
-        LARGE_INTEGER endTime;
-        QueryPerformanceCounter(&endTime);
-        recordPerformanceData(name, endTime.QuadPart - startTime.QuadPart);
+        PerfTicks endTime = perfTicks();
+        exitPerformanceScope(tag, startTime, endTime);
     }
 };
 
 #else
 
+typedef long long PerfTicks;
+
+struct PerfTag {
+    explicit PerfTag(const char *name) {}
+};
+
 static inline void initPerformanceData() {}
 static inline void printPerformanceData() {}
-static inline void recordPerformanceData(const char *name, const long long timeElapsed) {}
+static inline void recordPerformanceData(const PerfTag &tag, PerfTicks startTime, PerfTicks endTime) {}
+static inline void recordPerformanceValue(const PerfTag &tag, long long value) {}
 static inline void markPerformanceFrame() {}
+static inline bool setPerformanceCounters(bool enabled) { return false; }
+static inline bool writePerformanceCollapsedStacks(const char *filename) { return false; }
+static inline void setPerformanceFrameBudget(double milliseconds) {}
+static inline bool writeWorstFrameTrace(const char *filename) { return false; }
+static inline bool startPerformanceStream(const char *path) { return false; }
+static inline void stopPerformanceStream() {}
+static inline bool isPerformanceStreamRunning() { return false; }
+static inline bool startPerformanceSampling(int intervalMicros, bool backtraces) { return false; }
+static inline void stopPerformanceSampling() {}
+static inline bool writePerformanceSamples(const char *filename) { return false; }
+static inline int currentPerformanceTag() { return -1; }
+static inline const char *performanceTagName(int index) { return nullptr; }
+static inline void startPerformanceTrace(size_t maxEvents) {}
+static inline bool isPerformanceTraceRunning() { return false; }
+static inline bool writePerformanceTrace(const char *filename) { return false; }
 
 struct Perf {
-  Perf(const char *name) {}
+  Perf(const PerfTag &tag) {}
+};
+
+struct PerfSample {
+  PerfSample(const PerfTag &tag) {}
 };
 
 #endif //PERF
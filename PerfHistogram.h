@@ -0,0 +1,71 @@
+#ifndef COLLISION2D_PERFHISTOGRAM_H
+#define COLLISION2D_PERFHISTOGRAM_H
+
+#include <cstring>
+
+// Log-linear histogram in the style of HdrHistogram, used by Perf for times and recorded values.
+// Values under 2^(SUB_BITS + 1) get a bucket each, so they're exact. Every power of two above that is split
+// into 2^SUB_BITS buckets, so a bucket is within 1/32 of its values.
+// Fixed size, so recording never allocates.
+struct Histogram {
+    static const int SUB_BITS = 5;
+    static const int SUB_COUNT = 1 << SUB_BITS;
+    static const int MAX_BITS = 40; // values of 2^40 ticks (18 minutes in nS) and up land in the last bucket
+    static const int BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_COUNT;
+
+    unsigned counts[BUCKETS];
+    unsigned long long total;
+
+    Histogram() { clear(); }
+
+    void clear() {
+        memset(counts, 0, sizeof(counts));
+        total = 0;
+    }
+
+    static int bucketOf(unsigned long long value) {
+        if (value < SUB_COUNT) return int(value);
+        int bits = highestBit(value);
+        int shift = bits - SUB_BITS;
+        int bucket = (shift + 1) * SUB_COUNT + int((value >> shift) - SUB_COUNT);
+        return bucket < BUCKETS ? bucket : BUCKETS - 1;
+    }
+
+    // the middle of the values that land in bucket, which is the value itself for the exact ones
+    static double valueOf(int bucket) {
+        if (bucket < SUB_COUNT) return bucket;
+        int shift = bucket / SUB_COUNT - 1;
+        double low = double((unsigned long long)(bucket % SUB_COUNT + SUB_COUNT) << shift);
+        return low + double((1ULL << shift) - 1) / 2;
+    }
+
+    static int highestBit(unsigned long long value) {
+#ifdef __GNUC__
+        return 63 - __builtin_clzll(value);
+#else
+        int bit = 0;
+        while (value >>= 1) bit++;
+        return bit;
+#endif
+    }
+
+    void record(long long value) {
+        counts[bucketOf(value < 0 ? 0 : (unsigned long long) value)]++;
+        total++;
+    }
+
+    // percentile is from 0 to 100
+    double percentile(double percentile) const {
+        if (total == 0) return 0;
+        unsigned long long target = (unsigned long long)(total * percentile / 100);
+        if (target >= total) target = total - 1;
+        unsigned long long seen = 0;
+        for (int c = 0; c < BUCKETS; c++) {
+            seen += counts[c];
+            if (seen > target) return valueOf(c);
+        }
+        return valueOf(BUCKETS - 1);
+    }
+};
+
+#endif //COLLISION2D_PERFHISTOGRAM_H
@@ -0,0 +1,46 @@
+#ifndef COLLISION2D_PERFSTREAM_H
+#define COLLISION2D_PERFSTREAM_H
+
+#include <cstdint>
+
+// Wire format for startPerformanceStream. Every message is one SOCK_SEQPACKET packet on a unix domain socket,
+// so messages are never split, and both ends are on the same machine so there's no byte swapping.
+
+const char * const PERF_STREAM_DEFAULT_PATH = "/tmp/collision2d-perf.sock";
+const uint32_t PERF_STREAM_MAGIC = 0x31465250; // "PRF1"
+const int PERF_STREAM_MAX_NAME = 255;
+const int PERF_STREAM_MAX_PACKET = 64 * 1024;
+
+enum PerfStreamType {
+    PERF_STREAM_NAMES = 1, // count PerfStreamName entries, each followed by its name bytes
+    PERF_STREAM_FRAME = 2, // a PerfStreamFrame, then count PerfStreamTag entries
+};
+
+struct PerfStreamHeader {
+    uint32_t magic;
+    uint16_t type;
+    uint16_t count;
+};
+
+// names are sent once per client, before the first frame that uses them
+struct PerfStreamName {
+    uint16_t tag;
+    uint16_t length;
+};
+
+struct PerfStreamFrame {
+    uint64_t frame;
+    int64_t duration; // ticks since the last frame
+    int64_t frequency; // ticks per second
+    uint64_t dropped; // frames this client missed before this one
+};
+
+// only tags that ran this frame are sent
+struct PerfStreamTag {
+    uint16_t tag;
+    uint16_t reserved;
+    uint32_t calls;
+    int64_t ticks;
+};
+
+#endif //COLLISION2D_PERFSTREAM_H
@@ -0,0 +1,148 @@
+#include "alloc_count.h"
+#include "../Perf.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+#ifdef BENCH_COUNT_ALLOCATIONS
+
+#ifdef PERF
+static const int TAG_SLOTS = PERF_MAX_TAGS + 1; // the last one is for no tag
+#else
+static const int TAG_SLOTS = 1;
+#endif
+
+// Zero initialized before anything can allocate, since atomics have trivial constructors.
+struct Counts {
+    atomic<unsigned long long> allocations;
+    atomic<unsigned long long> bytes;
+    atomic<long long> live;
+    atomic<long long> peak;
+};
+
+static Counts total;
+static Counts tags[TAG_SLOTS];
+
+// in front of every block, so delete knows what to take off and from where. Keeps malloc's alignment.
+struct alignas(16) BlockHeader {
+    size_t size;
+    int slot;
+};
+
+static void raisePeak(Counts &counts, long long live) {
+    long long peak = counts.peak.load(memory_order_relaxed);
+    while (live > peak && !counts.peak.compare_exchange_weak(peak, live, memory_order_relaxed)) {}
+}
+
+static void charge(Counts &counts, size_t size) {
+    counts.allocations.fetch_add(1, memory_order_relaxed);
+    counts.bytes.fetch_add(size, memory_order_relaxed);
+    raisePeak(counts, counts.live.fetch_add(size, memory_order_relaxed) + (long long) size);
+}
+
+static void *countedAlloc(size_t size) {
+    BlockHeader *header = (BlockHeader *) malloc(sizeof(BlockHeader) + size);
+    if (!header) return nullptr;
+    int tag = currentPerformanceTag();
+    header->size = size;
+    header->slot = tag >= 0 && tag < TAG_SLOTS - 1 ? tag : TAG_SLOTS - 1;
+    charge(total, size);
+    charge(tags[header->slot], size);
+    return header + 1;
+}
+
+static void countedFree(void *block) {
+    if (!block) return;
+    BlockHeader *header = (BlockHeader *) block - 1;
+    total.live.fetch_sub(header->size, memory_order_relaxed);
+    tags[header->slot].live.fetch_sub(header->size, memory_order_relaxed);
+    free(header);
+}
+
+void *operator new(size_t size) {
+    void *block = countedAlloc(size);
+    if (!block) throw bad_alloc();
+    return block;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void *operator new(size_t size, const nothrow_t &) noexcept {
+    return countedAlloc(size);
+}
+
+void *operator new[](size_t size, const nothrow_t &) noexcept {
+    return countedAlloc(size);
+}
+
+void operator delete(void *block) noexcept {
+    countedFree(block);
+}
+
+void operator delete[](void *block) noexcept {
+    countedFree(block);
+}
+
+void operator delete(void *block, const nothrow_t &) noexcept {
+    countedFree(block);
+}
+
+void operator delete[](void *block, const nothrow_t &) noexcept {
+    countedFree(block);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void *block, size_t) noexcept {
+    countedFree(block);
+}
+
+void operator delete[](void *block, size_t) noexcept {
+    countedFree(block);
+}
+#endif
+
+static AllocStats read(const Counts &counts) {
+    AllocStats stats;
+    stats.allocations = counts.allocations.load(memory_order_relaxed);
+    stats.bytes = counts.bytes.load(memory_order_relaxed);
+    stats.live = counts.live.load(memory_order_relaxed);
+    stats.peak = counts.peak.load(memory_order_relaxed);
+    return stats;
+}
+
+bool isAllocCountingEnabled() {
+    return true;
+}
+
+AllocStats allocStats() {
+    return read(total);
+}
+
+void resetAllocPeak() {
+    total.peak.store(total.live.load(memory_order_relaxed), memory_order_relaxed);
+}
+
+AllocStats tagAllocStats(int tag) {
+    return read(tags[tag >= 0 && tag < TAG_SLOTS - 1 ? tag : TAG_SLOTS - 1]);
+}
+
+void resetTagAllocPeaks() {
+    for (Counts &counts : tags) {
+        counts.peak.store(counts.live.load(memory_order_relaxed), memory_order_relaxed);
+    }
+}
+
+#else
+
+bool isAllocCountingEnabled() { return false; }
+AllocStats allocStats() { return AllocStats(); }
+void resetAllocPeak() {}
+AllocStats tagAllocStats(int tag) { return AllocStats(); }
+void resetTagAllocPeaks() {}
+
+#endif //BENCH_COUNT_ALLOCATIONS
@@ -0,0 +1,29 @@
+// Counting replacements for the global operator new and delete, built in with BENCH_COUNT_ALLOCATIONS.
+// Every allocation is charged to the benchmark totals and to the innermost Perf tag open when it was made.
+
+#ifndef COLLISION2D_ALLOC_COUNT_H
+#define COLLISION2D_ALLOC_COUNT_H
+
+#include <cstddef>
+
+struct AllocStats {
+    unsigned long long allocations = 0;
+    unsigned long long bytes = 0; // asked for, not counting the allocator's own overhead
+    long long live = 0; // bytes allocated and not freed yet
+    long long peak = 0; // the most live has been since the last resetAllocPeak
+};
+
+// false when the counting operators weren't built in, in which case everything reads as zero
+bool isAllocCountingEnabled();
+
+// totals for the whole process
+AllocStats allocStats();
+// starts a new peak from what's live now
+void resetAllocPeak();
+
+// Totals for allocations made while tag was innermost, -1 for no tag. Bytes freed under another tag
+// still come off the tag that allocated them.
+AllocStats tagAllocStats(int tag);
+void resetTagAllocPeaks();
+
+#endif //COLLISION2D_ALLOC_COUNT_H
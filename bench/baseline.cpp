@@ -0,0 +1,275 @@
+#include "baseline.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+
+using namespace std;
+
+// Just enough json to read back what --json writes. Skips anything it doesn't need.
+class JsonReader {
+public:
+    explicit JsonReader(const string &text) : text(text) {}
+
+    bool failed() const { return error; }
+
+    void skipSpace() {
+        while (pos < text.size() && isspace((unsigned char) text[pos])) pos++;
+    }
+
+    bool consume(char c) {
+        skipSpace();
+        if (pos < text.size() && text[pos] == c) {
+            pos++;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c) {
+        if (!consume(c)) error = true;
+    }
+
+    char peek() {
+        skipSpace();
+        return pos < text.size() ? text[pos] : 0;
+    }
+
+    string readString() {
+        string out;
+        expect('"');
+        // writeJsonString only escapes quotes and backslashes, so an escape is just the next character
+        while (!error && pos < text.size() && text[pos] != '"') {
+            if (text[pos] == '\\') pos++;
+            if (pos < text.size()) out += text[pos++];
+        }
+        expect('"');
+        return out;
+    }
+
+    double readNumber() {
+        skipSpace();
+        const char *start = text.c_str() + pos;
+        char *end;
+        double value = strtod(start, &end);
+        if (end == start) error = true;
+        pos += end - start;
+        return value;
+    }
+
+    void skipValue() {
+        char c = peek();
+        if (c == '"') {
+            readString();
+        } else if (c == '{') {
+            expect('{');
+            if (consume('}')) return;
+            do {
+                readString();
+                expect(':');
+                skipValue();
+            } while (!error && consume(','));
+            expect('}');
+        } else if (c == '[') {
+            expect('[');
+            if (consume(']')) return;
+            do {
+                skipValue();
+            } while (!error && consume(','));
+            expect(']');
+        } else if (isalpha((unsigned char) c)) {
+            while (pos < text.size() && isalpha((unsigned char) text[pos])) pos++;
+        } else {
+            readNumber();
+        }
+    }
+
+private:
+    const string &text;
+    size_t pos = 0;
+    bool error = false;
+};
+
+static void readEntry(JsonReader &json, BaselineEntry &entry) {
+    json.expect('{');
+    if (json.consume('}')) return;
+    do {
+        string key = json.readString();
+        json.expect(':');
+        if (key == "name") {
+            entry.name = json.readString();
+        } else if (key == "samples") {
+            json.expect('[');
+            if (json.consume(']')) continue;
+            do {
+                entry.samples.push_back(json.readNumber());
+            } while (!json.failed() && json.consume(','));
+            json.expect(']');
+        } else {
+            json.skipValue();
+        }
+    } while (!json.failed() && json.consume(','));
+    json.expect('}');
+}
+
+bool readBaseline(const char *filename, vector<BaselineEntry> &entries) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) return false;
+    string text;
+    char buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        text.append(buffer, count);
+    }
+    fclose(file);
+
+    JsonReader json(text);
+    json.expect('{');
+    if (json.consume('}')) return !json.failed();
+    do {
+        string key = json.readString();
+        json.expect(':');
+        if (key != "benchmarks") {
+            json.skipValue();
+            continue;
+        }
+        json.expect('[');
+        if (json.consume(']')) continue;
+        do {
+            entries.emplace_back();
+            readEntry(json, entries.back());
+        } while (!json.failed() && json.consume(','));
+        json.expect(']');
+    } while (!json.failed() && json.consume(','));
+    json.expect('}');
+    return !json.failed();
+}
+
+double median(vector<double> values) {
+    if (values.empty()) return 0;
+    sort(values.begin(), values.end());
+    size_t mid = values.size() / 2;
+    if (values.size() % 2) return values[mid];
+    return (values[mid - 1] + values[mid]) / 2;
+}
+
+static double medianAbsoluteDeviation(const vector<double> &values, double center) {
+    vector<double> deviations;
+    for (double value : values) {
+        deviations.push_back(fabs(value - center));
+    }
+    return median(deviations);
+}
+
+// pairs of (x, y) with x > y, counting ties as half
+static double uStatistic(const vector<double> &x, const vector<double> &y) {
+    double u = 0;
+    for (double a : x) {
+        for (double b : y) {
+            if (a > b) u += 1;
+            else if (a == b) u += 0.5;
+        }
+    }
+    return u;
+}
+
+static bool hasTies(const vector<double> &x, const vector<double> &y) {
+    vector<double> all(x);
+    all.insert(all.end(), y.begin(), y.end());
+    sort(all.begin(), all.end());
+    return adjacent_find(all.begin(), all.end()) != all.end();
+}
+
+static const size_t EXACT_LIMIT = 20; // samples per side, past which the normal approximation is good enough
+
+// How many orderings of n xs and m ys give each value of U, by adding the largest sample last.
+// An x added last beats all m ys, a y added last beats nothing.
+static vector<double> uCounts(size_t n, size_t m) {
+    vector<vector<vector<double>>> counts(n + 1, vector<vector<double>>(m + 1));
+    for (size_t i = 0; i <= n; i++) {
+        for (size_t j = 0; j <= m; j++) {
+            vector<double> &here = counts[i][j];
+            here.assign(i * j + 1, 0);
+            if (i == 0 || j == 0) {
+                here[0] = 1;
+                continue;
+            }
+            const vector<double> &lastX = counts[i - 1][j];
+            const vector<double> &lastY = counts[i][j - 1];
+            for (size_t u = 0; u < lastX.size(); u++) here[u + j] += lastX[u];
+            for (size_t u = 0; u < lastY.size(); u++) here[u] += lastY[u];
+        }
+    }
+    return counts[n][m];
+}
+
+// one sided p value for x tending to be larger than y
+static double mannWhitneyP(const vector<double> &x, const vector<double> &y) {
+    size_t n = x.size(), m = y.size();
+    double u = uStatistic(x, y);
+    if (n <= EXACT_LIMIT && m <= EXACT_LIMIT && !hasTies(x, y)) {
+        vector<double> counts = uCounts(n, m);
+        double total = 0, tail = 0;
+        for (size_t c = 0; c < counts.size(); c++) {
+            total += counts[c];
+            if (c >= u) tail += counts[c];
+        }
+        return tail / total;
+    }
+
+    // normal approximation, with the variance corrected for ties
+    vector<double> all(x);
+    all.insert(all.end(), y.begin(), y.end());
+    sort(all.begin(), all.end());
+    double ties = 0;
+    for (size_t c = 0; c < all.size();) {
+        size_t d = c;
+        while (d < all.size() && all[d] == all[c]) d++;
+        double t = double(d - c);
+        ties += t * t * t - t;
+        c = d;
+    }
+    double total = double(n + m);
+    double mean = n * m / 2.0;
+    double variance = n * m / 12.0 * ((total + 1) - ties / (total * (total - 1)));
+    if (variance <= 0) return 1;
+    double z = (u - mean - 0.5) / sqrt(variance);
+    return 0.5 * erfc(z / sqrt(2.0));
+}
+
+// the smallest p value the test can give with n and m samples: every x beating every y
+static double smallestP(size_t n, size_t m) {
+    double p = 1;
+    for (size_t c = 1; c <= n; c++) {
+        p = p * c / (m + c);
+    }
+    return p;
+}
+
+Comparison compareSamples(const vector<double> &baseline, const vector<double> &current, double alpha, double threshold) {
+    Comparison result;
+    result.baselineMedian = median(baseline);
+    result.currentMedian = median(current);
+    result.baselineMad = medianAbsoluteDeviation(baseline, result.baselineMedian);
+    result.currentMad = medianAbsoluteDeviation(current, result.currentMedian);
+    result.change = result.baselineMedian > 0 ? result.currentMedian / result.baselineMedian - 1 : 0;
+    result.tested = !baseline.empty() && !current.empty() && smallestP(current.size(), baseline.size()) < alpha;
+
+    bool slower, faster;
+    if (result.tested) {
+        result.pSlower = mannWhitneyP(current, baseline);
+        result.pFaster = mannWhitneyP(baseline, current);
+        slower = result.pSlower < alpha;
+        faster = result.pFaster < alpha;
+    } else {
+        result.pSlower = result.pFaster = 1;
+        double spread = 3 * (result.baselineMad + result.currentMad);
+        slower = result.currentMedian - result.baselineMedian > spread;
+        faster = result.baselineMedian - result.currentMedian > spread;
+    }
+    result.regression = slower && result.change > threshold;
+    result.improvement = faster && result.change < -threshold;
+    return result;
+}
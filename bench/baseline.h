@@ -0,0 +1,34 @@
+#ifndef COLLISION2D_BASELINE_H
+#define COLLISION2D_BASELINE_H
+
+#include <string>
+#include <vector>
+
+struct BaselineEntry {
+    std::string name;
+    std::vector<double> samples; // ns per op, one per repetition
+};
+
+// reads the benchmarks from a file written by --json. Returns false if it can't be read or parsed.
+bool readBaseline(const char *filename, std::vector<BaselineEntry> &entries);
+
+struct Comparison {
+    double baselineMedian, baselineMad;
+    double currentMedian, currentMad;
+    double change; // of the median, relative to the baseline
+    double pSlower; // chance of a shift at least this slow if nothing changed. Only valid if tested.
+    double pFaster;
+    bool tested; // false if there were too few samples for the test to reach alpha
+    bool regression;
+    bool improvement;
+};
+
+// Flags a change when the median moved by more than threshold (relative) and it isn't noise:
+// a one sided Mann-Whitney U test at alpha, or with too few samples for that,
+// the medians being further apart than three times their combined median absolute deviations.
+Comparison compareSamples(const std::vector<double> &baseline, const std::vector<double> &current,
+                          double alpha, double threshold);
+
+double median(std::vector<double> values);
+
+#endif //COLLISION2D_BASELINE_H
@@ -0,0 +1,304 @@
+// Headless benchmarks for the collision code. No window or GL needed.
+// usage: Collision2DBench [--list] [--filter text] [--exclude text] [--repetitions n] [--min-time ms] [--json file] [--perf]
+//                         [--baseline file] [--threshold percent] [--alpha p] [--assert-no-alloc]
+// A file written by --json is a baseline. Comparing against one exits with 1 if anything got slower.
+// Built with BENCH_COUNT_ALLOCATIONS, each benchmark also reports what its timed repetitions allocated,
+// and --assert-no-alloc exits with 1 if any of them allocated at all.
+
+#include "bench.h"
+#include "baseline.h"
+#include "alloc_count.h"
+#include "../Perf.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+struct Benchmark {
+    string name;
+    BenchBody body;
+    BenchSetup setup; // may be empty
+};
+
+struct BenchResult {
+    string name;
+    size_t ops; // per repetition
+    vector<double> samples; // ns per op, one per repetition
+    double nsPerOp; // median of samples
+    vector<pair<string, double>> counters;
+    unsigned long long allocations; // in the timed repetitions
+};
+
+static vector<Benchmark> benchmarks;
+static BenchResult *running;
+static volatile float sinkValue;
+
+void addBenchmark(const string &name, BenchBody body, BenchSetup setup) {
+    Benchmark bench;
+    bench.name = name;
+    bench.body = body;
+    bench.setup = setup;
+    benchmarks.push_back(bench);
+}
+
+void benchCounter(const char *name, double value) {
+    if (!running) return;
+    for (pair<string, double> &counter : running->counters) {
+        if (counter.first == name) {
+            counter.second = value;
+            return;
+        }
+    }
+    running->counters.emplace_back(name, value);
+}
+
+void benchSink(float value) {
+    sinkValue += value;
+}
+
+static double timeBody(const BenchBody &body, size_t ops) {
+    auto start = chrono::steady_clock::now();
+    body(ops);
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, nano>(end - start).count();
+}
+
+// grows the op count until one run takes at least minTime
+static size_t calibrate(const BenchBody &body, double minTime) {
+    size_t ops = 1;
+    while (true) {
+        double elapsed = timeBody(body, ops);
+        if (elapsed >= minTime || ops >= (size_t(1) << 40)) break;
+        if (elapsed < minTime / 100) {
+            ops *= 10;
+        } else {
+            ops = size_t(ops * (minTime / elapsed) * 1.2) + 1;
+        }
+    }
+    markPerformanceFrame();
+    return ops;
+}
+
+static BenchResult run(const Benchmark &bench, int repetitions, double minTime) {
+    BenchResult result;
+    result.name = bench.name;
+    if (bench.setup) bench.setup();
+    running = &result;
+    result.ops = calibrate(bench.body, minTime);
+    // calibrating already grew everything that grows, so what's left is the steady state
+    result.samples.reserve(repetitions);
+    result.allocations = 0;
+    unsigned long long bytes = 0;
+    long long peakLive = 0; // above what was live before
+    for (int c = 0; c < repetitions; c++) {
+        resetAllocPeak();
+        AllocStats before = allocStats();
+        double elapsed = timeBody(bench.body, result.ops);
+        AllocStats after = allocStats();
+        result.allocations += after.allocations - before.allocations;
+        bytes += after.bytes - before.bytes;
+        peakLive = std::max(peakLive, after.peak - before.live);
+        result.samples.push_back(elapsed / result.ops);
+        // keeps the per thread buffers from filling up and dropping scopes
+        markPerformanceFrame();
+    }
+    result.nsPerOp = median(result.samples);
+    if (isAllocCountingEnabled()) {
+        double totalOps = double(result.ops) * repetitions;
+        benchCounter("allocs_per_op", result.allocations / totalOps);
+        benchCounter("alloc_bytes_per_op", bytes / totalOps);
+        benchCounter("peak_live_bytes", double(peakLive));
+    }
+    running = nullptr;
+    return result;
+}
+
+static void writeJsonString(FILE *file, const string &text) {
+    fputc('"', file);
+    for (char c : text) {
+        if (c == '"' || c == '\\') fputc('\\', file);
+        fputc(c, file);
+    }
+    fputc('"', file);
+}
+
+static bool writeJson(const char *filename, const vector<BenchResult> &results, int repetitions, double minTime) {
+    FILE *file = fopen(filename, "w");
+    if (!file) {
+        fprintf(stderr, "Couldn't open %s\n", filename);
+        return false;
+    }
+    fprintf(file, "{\n  \"repetitions\": %d,\n  \"min_time_ms\": %g,\n  \"benchmarks\": [", repetitions, minTime / 1e6);
+    for (size_t c = 0; c < results.size(); c++) {
+        const BenchResult &result = results[c];
+        fprintf(file, "%s\n    {\"name\": ", c ? "," : "");
+        writeJsonString(file, result.name);
+        fprintf(file, ", \"ops\": %llu, \"ns_per_op\": %.4f, \"ops_per_sec\": %.1f, \"samples\": [",
+                (unsigned long long) result.ops, result.nsPerOp, 1e9 / result.nsPerOp);
+        for (size_t d = 0; d < result.samples.size(); d++) {
+            fprintf(file, "%s%.4f", d ? ", " : "", result.samples[d]);
+        }
+        fprintf(file, "], \"counters\": {");
+        for (size_t d = 0; d < result.counters.size(); d++) {
+            fprintf(file, "%s", d ? ", " : "");
+            writeJsonString(file, result.counters[d].first);
+            fprintf(file, ": %.17g", result.counters[d].second);
+        }
+        fprintf(file, "}}");
+    }
+    fprintf(file, "\n  ]\n}\n");
+    fclose(file);
+    return true;
+}
+
+// prints how each result moved from the baseline. Returns the number of regressions.
+static int compare(const vector<BenchResult> &results, const vector<BaselineEntry> &baseline, double alpha, double threshold) {
+    int regressions = 0;
+    printf("\n%-48s %22s %22s %8s %8s\n", "BENCHMARK", "BASELINE ns/op", "CURRENT ns/op", "CHANGE", "P");
+    for (const BenchResult &result : results) {
+        const BaselineEntry *entry = nullptr;
+        for (const BaselineEntry &old : baseline) {
+            if (old.name == result.name) entry = &old;
+        }
+        if (!entry || entry->samples.empty()) {
+            printf("%-48s %22s\n", result.name.c_str(), "new");
+            continue;
+        }
+        Comparison diff = compareSamples(entry->samples, result.samples, alpha, threshold);
+        char before[32], after[32], p[16];
+        snprintf(before, sizeof(before), "%.2f +- %.2f", diff.baselineMedian, diff.baselineMad);
+        snprintf(after, sizeof(after), "%.2f +- %.2f", diff.currentMedian, diff.currentMad);
+        if (diff.tested) {
+            snprintf(p, sizeof(p), "%.4f", diff.change > 0 ? diff.pSlower : diff.pFaster);
+        } else {
+            snprintf(p, sizeof(p), "mad");
+        }
+        const char *verdict = diff.regression ? "REGRESSION" : diff.improvement ? "improved" : "";
+        printf("%-48s %22s %22s %+7.1f%% %8s  %s\n", result.name.c_str(), before, after, diff.change * 100, p, verdict);
+        if (diff.regression) regressions++;
+    }
+    printf("%d regression%s, alpha %g, threshold %g%%\n", regressions, regressions == 1 ? "" : "s", alpha, threshold * 100);
+    return regressions;
+}
+
+// over the whole run, setup included
+static void printAllocationsByTag() {
+    printf("\nALLOCATIONS BY TAG\n");
+    for (int tag = -1; tag < 0 || performanceTagName(tag); tag++) {
+        AllocStats stats = tagAllocStats(tag);
+        if (stats.allocations == 0) continue;
+        printf("%12llu allocs %16llu bytes %14lld peak live  %s\n", stats.allocations, stats.bytes, stats.peak,
+               tag < 0 ? "(no tag)" : performanceTagName(tag));
+    }
+}
+
+static void usage() {
+    fprintf(stderr, "usage: Collision2DBench [--list] [--filter text] [--exclude text] [--repetitions n] [--min-time ms] [--json file] [--perf]\n"
+                    "                        [--baseline file] [--threshold percent] [--alpha p] [--assert-no-alloc]\n");
+}
+
+int main(int argc, char **argv) {
+    const char *filter = nullptr;
+    const char *exclude = nullptr;
+    const char *jsonFile = nullptr;
+    const char *baselineFile = nullptr;
+    double threshold = 0.05; // relative change in the median that counts
+    double alpha = 0.05;
+    int repetitions = 5;
+    double minTime = 20e6; // nS per repetition
+    bool list = false;
+    bool perf = false;
+    bool assertNoAlloc = false;
+
+    for (int c = 1; c < argc; c++) {
+        bool hasValue = c + 1 < argc;
+        if (!strcmp(argv[c], "--list")) {
+            list = true;
+        } else if (!strcmp(argv[c], "--perf")) {
+            perf = true;
+        } else if (!strcmp(argv[c], "--assert-no-alloc")) {
+            assertNoAlloc = true;
+        } else if (!strcmp(argv[c], "--filter") && hasValue) {
+            filter = argv[++c];
+        } else if (!strcmp(argv[c], "--exclude") && hasValue) {
+            exclude = argv[++c];
+        } else if (!strcmp(argv[c], "--repetitions") && hasValue) {
+            repetitions = std::max(1, atoi(argv[++c]));
+        } else if (!strcmp(argv[c], "--min-time") && hasValue) {
+            minTime = atof(argv[++c]) * 1e6;
+        } else if (!strcmp(argv[c], "--json") && hasValue) {
+            jsonFile = argv[++c];
+        } else if (!strcmp(argv[c], "--baseline") && hasValue) {
+            baselineFile = argv[++c];
+        } else if (!strcmp(argv[c], "--threshold") && hasValue) {
+            threshold = atof(argv[++c]) / 100;
+        } else if (!strcmp(argv[c], "--alpha") && hasValue) {
+            alpha = atof(argv[++c]);
+        } else {
+            usage();
+            return 2;
+        }
+    }
+
+    if (assertNoAlloc && !isAllocCountingEnabled()) {
+        fprintf(stderr, "--assert-no-alloc needs a build with BENCH_COUNT_ALLOCATIONS\n");
+        return 2;
+    }
+
+    // read it first, so a bad path fails before the long part
+    vector<BaselineEntry> baseline;
+    if (baselineFile && !readBaseline(baselineFile, baseline)) {
+        fprintf(stderr, "Couldn't read baseline %s\n", baselineFile);
+        return 1;
+    }
+
+    initPerformanceData();
+    addCollisionBenchmarks();
+    addScalingBenchmarks();
+
+    vector<BenchResult> results;
+    int allocating = 0;
+    for (const Benchmark &bench : benchmarks) {
+        if (filter && bench.name.find(filter) == string::npos) continue;
+        if (exclude && bench.name.find(exclude) != string::npos) continue;
+        if (list) {
+            printf("%s\n", bench.name.c_str());
+            continue;
+        }
+        results.push_back(run(bench, repetitions, minTime));
+        const BenchResult &result = results.back();
+        printf("%-48s %12.2f ns/op %14.2f ops/s", result.name.c_str(), result.nsPerOp, 1e9 / result.nsPerOp);
+        for (const pair<string, double> &counter : result.counters) {
+            printf("  %s=%.6g", counter.first.c_str(), counter.second);
+        }
+        printf("\n");
+        if (assertNoAlloc && result.allocations > 0) {
+            printf("  allocated %llu times after calibrating\n", result.allocations);
+            allocating++;
+        }
+        fflush(stdout);
+    }
+
+    if (perf) {
+        printPerformanceData();
+    }
+    if (isAllocCountingEnabled() && !results.empty()) {
+        printAllocationsByTag();
+    }
+    if (assertNoAlloc && allocating > 0) {
+        printf("%d benchmark%s allocated in the steady state\n", allocating, allocating == 1 ? "" : "s");
+        return 1;
+    }
+    if (jsonFile && !writeJson(jsonFile, results, repetitions, minTime)) {
+        return 1;
+    }
+    if (baselineFile && !list && compare(results, baseline, alpha, threshold) > 0) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,31 @@
+#ifndef COLLISION2D_BENCH_H
+#define COLLISION2D_BENCH_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+// Runs ops operations of whatever is being measured, as fast as it can.
+// Called with growing counts while calibrating, then once per repetition, so set up shared state before adding it.
+typedef std::function<void(size_t ops)> BenchBody;
+
+// For state too big to build for every benchmark up front, like the million body scenes.
+// Called once right before the benchmark calibrates, outside of any timing, and only if it passes the filter.
+typedef std::function<void()> BenchSetup;
+
+// names are suite/case/parameters, and --filter matches any part of them
+void addBenchmark(const std::string &name, BenchBody body, BenchSetup setup = BenchSetup());
+
+// Attaches a number to the benchmark that's running, like a count of what it found or a phase time.
+// Reported next to ns/op. If it's set more than once, the last value wins. Only allocates the first time a name is set.
+void benchCounter(const char *name, double value);
+
+// Keeps a result alive so the optimizer can't drop the work that made it.
+// Accumulate into a local while running and sink that once at the end.
+void benchSink(float value);
+
+// the suites, each in its own file
+void addCollisionBenchmarks();
+void addScalingBenchmarks();
+
+#endif //COLLISION2D_BENCH_H
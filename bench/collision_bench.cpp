@@ -0,0 +1,315 @@
+// support queries, pair tests, tessellation and broadphase
+
+#include "bench.h"
+#include "../gjk.h"
+#include "../broadphase.h"
+
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace glm;
+using namespace std;
+
+static const unsigned SEED = 0x2d2d;
+static const int DIRECTIONS = 1024; // power of two
+static const int PAIRS = 256; // power of two
+
+// owns every shape the benchmarks point at, for the life of the program
+static vector<unique_ptr<Collider2D>> shapes;
+
+template<class T>
+static T *makeShape() {
+    T *shape = new T();
+    shapes.emplace_back(shape);
+    return shape;
+}
+
+static float randomFloat(mt19937 &rng, float lo, float hi) {
+    return uniform_real_distribution<float>(lo, hi)(rng);
+}
+
+static CircleCollider2D *makeCircle(vec2 center, float radius) {
+    CircleCollider2D *circle = makeShape<CircleCollider2D>();
+    circle->center = center;
+    circle->radius = radius;
+    return circle;
+}
+
+static BoxCollider2D *makeBox(vec2 center, vec2 halfSize) {
+    BoxCollider2D *box = makeShape<BoxCollider2D>();
+    box->center = center;
+    box->halfSize = halfSize;
+    return box;
+}
+
+// vertices at jittered angles around a circle, so every one is on the hull
+static PolygonCollider2D *makePolygon(mt19937 &rng, int vertices, vec2 center, float radius) {
+    PolygonCollider2D *polygon = makeShape<PolygonCollider2D>();
+    float step = 2 * float(M_PI) / vertices;
+    for (int c = 0; c < vertices; c++) {
+        float angle = (c + randomFloat(rng, -0.3f, 0.3f)) * step;
+        polygon->points.push_back(center + radius * vec2(cos(angle), sin(angle)));
+    }
+    polygon->buildHull();
+    return polygon;
+}
+
+template<class T>
+static T *makePair(Collider2D *a, Collider2D *b) {
+    T *pair = makeShape<T>();
+    pair->a = a;
+    pair->b = b;
+    return pair;
+}
+
+// the shape the demo tests the cursor with: (line + circle) - triangle
+static Collider2D *makeDemoShape(mt19937 &rng) {
+    AddCollider2D *longCircle = makePair<AddCollider2D>(makePolygon(rng, 3, vec2(0, 1), 1.5f), makeCircle(vec2(0, -1), 1));
+    return makePair<SubCollider2D>(longCircle, makePolygon(rng, 4, vec2(0, 0), 0.5f));
+}
+
+static vector<vec2> randomDirections(mt19937 &rng) {
+    vector<vec2> directions;
+    for (int c = 0; c < DIRECTIONS; c++) {
+        float angle = randomFloat(rng, 0, 2 * float(M_PI));
+        directions.push_back(vec2(cos(angle), sin(angle)));
+    }
+    return directions;
+}
+
+// one slow turn, like the directions of successive gjk iterations or frames
+static vector<vec2> coherentDirections() {
+    vector<vec2> directions;
+    for (int c = 0; c < DIRECTIONS; c++) {
+        float angle = c * 2 * float(M_PI) / DIRECTIONS;
+        directions.push_back(vec2(cos(angle), sin(angle)));
+    }
+    return directions;
+}
+
+static void addSupportBenchmark(const string &name, Collider2D *shape, const vector<vec2> &directions) {
+    addBenchmark("support/" + name, [shape, directions](size_t ops) {
+        vec2 sum(0, 0);
+        for (size_t c = 0; c < ops; c++) {
+            sum += shape->findSupport(directions[c & (DIRECTIONS - 1)]);
+        }
+        benchSink(sum.x + sum.y);
+    });
+}
+
+// depth nodes of T, each combining the chain so far with another quad
+template<class T>
+static Collider2D *makeChain(mt19937 &rng, int depth) {
+    Collider2D *chain = makePolygon(rng, 4, vec2(0, 0), 1);
+    for (int c = 0; c < depth; c++) {
+        chain = makePair<T>(chain, makePolygon(rng, 4, vec2(0, 0), 0.25f));
+    }
+    return chain;
+}
+
+static void addSupportBenchmarks(mt19937 &rng) {
+    vector<pair<string, Collider2D *>> cases;
+    cases.emplace_back("circle", makeCircle(vec2(0, 0), 1));
+    cases.emplace_back("box", makeBox(vec2(0, 0), vec2(1, 0.5f)));
+    for (int vertices : {3, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096}) {
+        cases.emplace_back("polygon/" + to_string(vertices), makePolygon(rng, vertices, vec2(0, 0), 1));
+    }
+    for (int depth = 1; depth <= 8; depth++) {
+        cases.emplace_back("add-chain/" + to_string(depth), makeChain<AddCollider2D>(rng, depth));
+    }
+    for (int depth = 1; depth <= 8; depth++) {
+        cases.emplace_back("sub-chain/" + to_string(depth), makeChain<SubCollider2D>(rng, depth));
+    }
+    cases.emplace_back("demo", makeDemoShape(rng));
+
+    vector<vec2> random = randomDirections(rng);
+    vector<vec2> coherent = coherentDirections();
+    for (const pair<string, Collider2D *> &shape : cases) {
+        addSupportBenchmark(shape.first + "/random", shape.second, random);
+        addSupportBenchmark(shape.first + "/coherent", shape.second, coherent);
+    }
+}
+
+typedef Collider2D *(*ShapeMaker)(mt19937 &rng, vec2 center);
+
+static Collider2D *circleAt(mt19937 &rng, vec2 center) {
+    return makeCircle(center, randomFloat(rng, 0.5f, 1));
+}
+
+static Collider2D *boxAt(mt19937 &rng, vec2 center) {
+    return makeBox(center, vec2(randomFloat(rng, 0.3f, 1), randomFloat(rng, 0.3f, 1)));
+}
+
+static Collider2D *polygonAt(mt19937 &rng, vec2 center) {
+    return makePolygon(rng, 8, center, randomFloat(rng, 0.5f, 1));
+}
+
+static Collider2D *compositeAt(mt19937 &rng, vec2 center) {
+    PolygonCollider2D *polygon = makePolygon(rng, 5, center, randomFloat(rng, 0.3f, 0.6f));
+    return makePair<AddCollider2D>(polygon, makeCircle(vec2(0, 0), randomFloat(rng, 0.2f, 0.4f)));
+}
+
+// random placements where about half of the pairs overlap
+static void addPairBenchmark(mt19937 &rng, const string &name, ShapeMaker makeA, ShapeMaker makeB) {
+    vector<Collider2D *> as, bs;
+    for (int c = 0; c < PAIRS; c++) {
+        as.push_back(makeA(rng, vec2(0, 0)));
+        bs.push_back(makeB(rng, vec2(randomFloat(rng, -2.5f, 2.5f), randomFloat(rng, -2.5f, 2.5f))));
+    }
+    addBenchmark("gjk/collides/" + name, [as, bs](size_t ops) {
+        int hits = 0;
+        for (size_t c = 0; c < ops; c++) {
+            int pair = int(c & (PAIRS - 1));
+            hits += collides(as[pair], bs[pair]);
+        }
+        benchSink(float(hits));
+    });
+    // outputs live between calls, so the only allocations left are the collision code's own
+    shared_ptr<vector<vec2>> points = make_shared<vector<vec2>>();
+    addBenchmark("gjk/intersects/" + name, [as, bs, points](size_t ops) {
+        int hits = 0;
+        for (size_t c = 0; c < ops; c++) {
+            int pair = int(c & (PAIRS - 1));
+            points->clear();
+            hits += intersects(as[pair], bs[pair], *points);
+        }
+        benchSink(float(hits));
+    });
+}
+
+static void addPairBenchmarks(mt19937 &rng) {
+    addPairBenchmark(rng, "circle-circle", circleAt, circleAt);
+    addPairBenchmark(rng, "circle-polygon", circleAt, polygonAt);
+    addPairBenchmark(rng, "circle-box", circleAt, boxAt);
+    addPairBenchmark(rng, "box-box", boxAt, boxAt);
+    addPairBenchmark(rng, "polygon-polygon", polygonAt, polygonAt);
+    addPairBenchmark(rng, "polygon-box", polygonAt, boxAt);
+    addPairBenchmark(rng, "composite-polygon", compositeAt, polygonAt);
+}
+
+static void addTessellationBenchmark(const string &name, Collider2D *shape, float epsilon) {
+    shared_ptr<vector<vec2>> bounds = make_shared<vector<vec2>>();
+    addBenchmark("tessellate/findBounds/" + name, [shape, epsilon, bounds](size_t ops) {
+        size_t points = 0;
+        for (size_t c = 0; c < ops; c++) {
+            bounds->clear();
+            findBounds(shape, *bounds, epsilon);
+            points += bounds->size();
+        }
+        benchSink(float(points));
+    });
+}
+
+static void addTessellationBenchmarks(mt19937 &rng) {
+    Collider2D *circle = makeCircle(vec2(0, 0), 1);
+    Collider2D *demo = makeDemoShape(rng);
+    addTessellationBenchmark("circle/0.01", circle, 0.01f);
+    addTessellationBenchmark("circle/0.001", circle, 0.001f);
+    addTessellationBenchmark("demo/0.01", demo, 0.01f);
+    addTessellationBenchmark("demo/0.001", demo, 0.001f);
+
+    shared_ptr<OutlineCache> cache = make_shared<OutlineCache>();
+    shared_ptr<vector<vec2>> bounds = make_shared<vector<vec2>>();
+    addBenchmark("tessellate/cached/demo/0.001", [cache, demo, bounds](size_t ops) {
+        size_t points = 0;
+        for (size_t c = 0; c < ops; c++) {
+            bounds->clear();
+            cache->findBounds(demo, *bounds, 0.001f);
+            points += bounds->size();
+        }
+        benchSink(float(points));
+    });
+
+    shared_ptr<PolygonCollider2D> baked = make_shared<PolygonCollider2D>();
+    addBenchmark("tessellate/bakeMinkowski/demo/0.001", [demo, baked](size_t ops) {
+        size_t points = 0;
+        for (size_t c = 0; c < ops; c++) {
+            bakeMinkowski(demo, *baked, 0.001f);
+            points += baked->points.size();
+        }
+        benchSink(float(points));
+    });
+}
+
+// boxes of 0.5 to 2 units, spread so each overlaps a few others
+static vector<Aabb> randomBoxes(mt19937 &rng, int count) {
+    float side = 2 * sqrt(float(count));
+    vector<Aabb> boxes;
+    for (int c = 0; c < count; c++) {
+        vec2 center(randomFloat(rng, 0, side), randomFloat(rng, 0, side));
+        vec2 half(randomFloat(rng, 0.25f, 1), randomFloat(rng, 0.25f, 1));
+        Aabb box;
+        box.min = center - half;
+        box.max = center + half;
+        boxes.push_back(box);
+    }
+    return boxes;
+}
+
+struct MovingBoxes {
+    vector<Aabb> boxes;
+    vector<vec2> velocities;
+    SweepAndPrune sap;
+    size_t step = 0;
+};
+
+static void addBroadphaseBenchmarks(mt19937 &rng) {
+    vector<Collider2D *> polygons;
+    for (int c = 0; c < PAIRS; c++) {
+        polygons.push_back(polygonAt(rng, vec2(0, 0)));
+    }
+    addBenchmark("broadphase/findAabb/polygon", [polygons](size_t ops) {
+        float sum = 0;
+        for (size_t c = 0; c < ops; c++) {
+            Aabb box = findAabb(polygons[c & (PAIRS - 1)]);
+            sum += box.max.x - box.min.y;
+        }
+        benchSink(sum);
+    });
+
+    for (int count : {1000, 10000}) {
+        string suffix = "/" + to_string(count);
+        shared_ptr<vector<Aabb>> boxes = make_shared<vector<Aabb>>(randomBoxes(rng, count));
+
+        shared_ptr<vector<pair<int, int>>> pairs = make_shared<vector<pair<int, int>>>();
+        shared_ptr<SweepAndPrune> still = make_shared<SweepAndPrune>();
+        addBenchmark("broadphase/sap/static" + suffix, [boxes, still, pairs](size_t ops) {
+            size_t found = 0;
+            for (size_t c = 0; c < ops; c++) {
+                still->findPairs(*boxes, *pairs);
+                found += pairs->size();
+            }
+            benchSink(float(found));
+        });
+
+        // every box drifts a little each step, back and forth so the scene stays the same size
+        shared_ptr<MovingBoxes> moving = make_shared<MovingBoxes>();
+        moving->boxes = *boxes;
+        for (int c = 0; c < count; c++) {
+            moving->velocities.push_back(vec2(randomFloat(rng, -0.05f, 0.05f), randomFloat(rng, -0.05f, 0.05f)));
+        }
+        addBenchmark("broadphase/sap/moving" + suffix, [moving, pairs](size_t ops) {
+            size_t found = 0;
+            for (size_t c = 0; c < ops; c++) {
+                float sign = (moving->step++ / 16) % 2 ? -1.f : 1.f;
+                for (size_t d = 0; d < moving->boxes.size(); d++) {
+                    moving->boxes[d].min += sign * moving->velocities[d];
+                    moving->boxes[d].max += sign * moving->velocities[d];
+                }
+                moving->sap.findPairs(moving->boxes, *pairs);
+                found += pairs->size();
+            }
+            benchSink(float(found));
+        });
+    }
+}
+
+void addCollisionBenchmarks() {
+    mt19937 rng(SEED);
+    addSupportBenchmarks(rng);
+    addPairBenchmarks(rng);
+    addTessellationBenchmarks(rng);
+    addBroadphaseBenchmarks(rng);
+}
@@ -0,0 +1,149 @@
+// Whole collision steps over generated scenes from 1k to 1M bodies.
+// One op is one step: boxes for every body, the broadphase, then collides on every pair it finds.
+
+#include "bench.h"
+#include "../gjk.h"
+#include "../broadphase.h"
+#include "../scenegen.h"
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+using namespace glm;
+using namespace std;
+
+enum Distribution {
+    DIST_UNIFORM,   // same size bodies spread evenly
+    DIST_CLUSTERED, // same size bodies packed into clumps
+    DIST_SIZES,     // spread evenly, but most bodies are small and a few are huge
+    DIST_COUNT
+};
+
+enum ShapeMix {
+    MIX_CIRCLES,
+    MIX_POLYGONS,   // 3 to 8 vertices
+    MIX_HULLS,      // 32 to 64 vertices
+    MIX_COMPOSITES, // polygon + circle or polygon
+    MIX_MIXED,      // all of the above, capsules and boxes
+    MIX_COUNT
+};
+
+static const char *distributionNames[DIST_COUNT] = {"uniform", "clustered", "sizes"};
+static const char *mixNames[MIX_COUNT] = {"circles", "polygons", "hulls", "composites", "mixed"};
+
+static const int BODIES_PER_CLUSTER = 64;
+
+// the scene being stepped. Only one is alive at a time, since the big ones take a lot of memory.
+struct ScalingRun {
+    string name;
+    Scene scene;
+    vector<Aabb> boxes;
+    vector<pair<int, int>> pairs;
+    SweepAndPrune sap;
+};
+
+static unique_ptr<ScalingRun> current;
+
+static SceneSettings settingsFor(Distribution distribution, ShapeMix mix, int count) {
+    SceneSettings settings;
+    settings.seed = unsigned(count * 31 + distribution * 7 + mix);
+    settings.bodies = count;
+    if (distribution == DIST_CLUSTERED) {
+        settings.clusterSize = BODIES_PER_CLUSTER;
+    } else if (distribution == DIST_SIZES) {
+        settings.minRadius = 0.25f;
+        settings.maxRadius = 8;
+        settings.sizeSkew = 6;
+    }
+
+    for (float &weight : settings.shapeWeights) weight = 0;
+    switch (mix) {
+        case MIX_CIRCLES:
+            settings.shapeWeights[SCENE_CIRCLE] = 1;
+            break;
+        case MIX_POLYGONS:
+            settings.shapeWeights[SCENE_POLYGON] = 1;
+            break;
+        case MIX_HULLS:
+            settings.shapeWeights[SCENE_POLYGON] = 1;
+            settings.minVertices = 32;
+            settings.maxVertices = 64;
+            break;
+        case MIX_COMPOSITES:
+            settings.shapeWeights[SCENE_COMPOSITE] = 1;
+            settings.minVertices = 4;
+            settings.maxVertices = 6;
+            break;
+        default:
+            for (float &weight : settings.shapeWeights) weight = 1;
+            break;
+    }
+    return settings;
+}
+
+// generates the scene for a benchmark, freeing the last one first
+static void generateRun(const string &name, Distribution distribution, ShapeMix mix, int count) {
+    if (current && current->name == name) return;
+    current.reset();
+    current.reset(new ScalingRun());
+    current->name = name;
+    generateScene(settingsFor(distribution, mix, count), current->scene);
+}
+
+static double since(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+}
+
+static void step(ScalingRun &run, size_t ops) {
+    double aabbTime = 0, broadphaseTime = 0, narrowphaseTime = 0;
+    size_t contacts = 0;
+    for (size_t c = 0; c < ops; c++) {
+        auto start = chrono::steady_clock::now();
+        run.boxes.resize(run.scene.bodies.size());
+        for (size_t d = 0; d < run.boxes.size(); d++) {
+            run.boxes[d] = findAabb(run.scene.bodies[d].collider);
+        }
+        aabbTime += since(start);
+
+        start = chrono::steady_clock::now();
+        run.sap.findPairs(run.boxes, run.pairs);
+        broadphaseTime += since(start);
+
+        start = chrono::steady_clock::now();
+        contacts = 0;
+        for (const pair<int, int> &pair : run.pairs) {
+            contacts += collides(run.scene.bodies[pair.first].collider, run.scene.bodies[pair.second].collider);
+        }
+        narrowphaseTime += since(start);
+    }
+
+    benchCounter("aabb_ns", aabbTime / ops);
+    benchCounter("broadphase_ns", broadphaseTime / ops);
+    benchCounter("narrowphase_ns", narrowphaseTime / ops);
+    benchCounter("pairs", double(run.pairs.size()));
+    benchCounter("contacts", double(contacts));
+    benchCounter("scene_bytes", double(run.scene.bytes()));
+    // the sweep keeps an int per body
+    benchCounter("broadphase_bytes", double(run.boxes.capacity() * sizeof(Aabb) +
+                                            run.pairs.capacity() * sizeof(pair<int, int>) +
+                                            run.boxes.size() * sizeof(int)));
+    benchSink(float(contacts));
+}
+
+void addScalingBenchmarks() {
+    for (int count : {1000, 10000, 100000, 1000000}) {
+        for (int distribution = 0; distribution < DIST_COUNT; distribution++) {
+            for (int mix = 0; mix < MIX_COUNT; mix++) {
+                string name = string("scaling/") + distributionNames[distribution] + "/" + mixNames[mix] + "/" + to_string(count);
+                // the scenes are only generated in setup, since building a million bodies would swamp the first
+                // calibration run, and they're too big to keep all of them around
+                addBenchmark(name, [](size_t ops) {
+                    step(*current, ops);
+                }, [name, distribution, mix, count]() {
+                    generateRun(name, Distribution(distribution), ShapeMix(mix), count);
+                });
+            }
+        }
+    }
+}
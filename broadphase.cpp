@@ -0,0 +1,74 @@
+#include "broadphase.h"
+#include "gjk.h"
+#include "Perf.h"
+
+#include <algorithm>
+
+using namespace glm;
+using namespace std;
+
+Aabb findAabb(Collider2D *collider) {
+    Aabb box;
+    box.min.x = collider->findSupport(vec2(-1, 0)).x;
+    box.min.y = collider->findSupport(vec2(0, -1)).y;
+    box.max.x = collider->findSupport(vec2( 1, 0)).x;
+    box.max.y = collider->findSupport(vec2(0,  1)).y;
+    return box;
+}
+
+// Insertion sort, which is close to linear when the order is nearly right already.
+// Gives up and returns false if it has moved more than limit elements.
+static bool resort(vector<int> &order, const vector<Aabb> &boxes, size_t limit) {
+    size_t moves = 0;
+    for (size_t c = 1; c < order.size(); c++) {
+        int index = order[c];
+        float key = boxes[index].min.x;
+        size_t pos = c;
+        while (pos > 0 && boxes[order[pos - 1]].min.x > key) {
+            order[pos] = order[pos - 1];
+            pos--;
+            if (++moves > limit) {
+                order[pos] = index;
+                return false;
+            }
+        }
+        order[pos] = index;
+    }
+    return true;
+}
+
+void SweepAndPrune::findPairs(const vector<Aabb> &boxes, vector<pair<int, int>> &pairs) {
+    static PerfTag broadphaseTag("Broadphase");
+    Perf stat(broadphaseTag);
+
+    pairs.clear();
+
+    auto byMinX = [&boxes](int a, int b) { return boxes[a].min.x < boxes[b].min.x; };
+    if (order.size() != boxes.size()) {
+        order.resize(boxes.size());
+        for (size_t c = 0; c < order.size(); c++) {
+            order[c] = int(c);
+        }
+        sort(order.begin(), order.end(), byMinX);
+    } else if (!resort(order, boxes, 8 * boxes.size())) {
+        // too much moved for insertion sort to be worth it
+        sort(order.begin(), order.end(), byMinX);
+    }
+
+    for (size_t c = 0; c < order.size(); c++) {
+        int a = order[c];
+        const Aabb &boxA = boxes[a];
+        for (size_t d = c + 1; d < order.size(); d++) {
+            int b = order[d];
+            const Aabb &boxB = boxes[b];
+            if (boxB.min.x > boxA.max.x) break;
+            if (boxA.min.y <= boxB.max.y && boxB.min.y <= boxA.max.y) {
+                pairs.emplace_back(std::min(a, b), std::max(a, b));
+            }
+        }
+    }
+}
+
+void SweepAndPrune::clear() {
+    order.clear();
+}
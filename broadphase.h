@@ -0,0 +1,35 @@
+#ifndef COLLISION2D_BROADPHASE_H
+#define COLLISION2D_BROADPHASE_H
+
+#include <glm/glm.hpp>
+#include <utility>
+#include <vector>
+
+struct Collider2D;
+
+struct Aabb {
+    glm::vec2 min;
+    glm::vec2 max;
+};
+
+// the smallest box around the collider, from its support points along the axes
+Aabb findAabb(Collider2D *collider);
+
+inline bool overlaps(const Aabb &a, const Aabb &b) {
+    return a.min.x <= b.max.x && b.min.x <= a.max.x &&
+           a.min.y <= b.max.y && b.min.y <= a.max.y;
+}
+
+// Finds the pairs of boxes that overlap by sorting them along x and sweeping.
+// The sort order is kept between calls, so boxes that only move a little each step are cheap to re-sort.
+class SweepAndPrune {
+public:
+    // replaces pairs with the indices (first < second) of every overlapping pair of boxes
+    void findPairs(const std::vector<Aabb> &boxes, std::vector<std::pair<int, int>> &pairs);
+    void clear();
+
+private:
+    std::vector<int> order; // indices into boxes, by min.x as of the last call
+};
+
+#endif //COLLISION2D_BROADPHASE_H
@@ -5,6 +5,10 @@
 #include "gjk.h"
 #include "Perf.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
 using namespace glm;
 using namespace std;
 
@@ -33,36 +37,380 @@ vec2 PolygonCollider2D::findSupport(vec2 direction) {
     return max_val;
 }
 
-// recursively finds points on the collider's surface in ccw order, defining it to within epsilon of its mathematical definition
-static void findBounds(Collider2D *collider, vec2 right, vec2 left, vector<vec2> &bounds, float epsilon) {
-    vec2 edge = left - right; // the ccw direction around the triangle
+vec2 BoxCollider2D::findSupport(vec2 direction) {
+    return center + vec2(direction.x < 0 ? -halfSize.x : halfSize.x,
+                         direction.y < 0 ? -halfSize.y : halfSize.y);
+}
+
+// closest point to the origin on the segment ab
+static vec2 closestOnSegment(vec2 a, vec2 b) {
+    vec2 ab = b - a;
+    float len2 = dot(ab, ab);
+    if (len2 == 0) return a;
+    float t = clamp(-dot(a, ab) / len2, 0.f, 1.f);
+    return a + t * ab;
+}
+
+static float cross(vec2 a, vec2 b) {
+    return a.x * b.y - a.y * b.x;
+}
+
+// monotone chain. Leaves points as the ccw hull, without collinear points.
+static void convexHull(vector<vec2> &points) {
+    if (points.size() < 3) {
+        if (points.size() == 2 && points[0] == points[1]) points.pop_back();
+        return;
+    }
+
+    sort(points.begin(), points.end(), [](const vec2 &a, const vec2 &b) {
+        return a.x < b.x || (a.x == b.x && a.y < b.y);
+    });
+
+    vector<vec2> hull(2 * points.size());
+    size_t k = 0;
+    for (size_t c = 0; c < points.size(); c++) { // lower hull
+        while (k >= 2 && cross(hull[k-1] - hull[k-2], points[c] - hull[k-2]) <= 0) k--;
+        hull[k++] = points[c];
+    }
+    for (size_t c = points.size() - 1, lower = k + 1; c > 0; c--) { // upper hull
+        while (k >= lower && cross(hull[k-1] - hull[k-2], points[c-1] - hull[k-2]) <= 0) k--;
+        hull[k++] = points[c-1];
+    }
+    hull.resize(k - 1); // the last point is the first point again
+    points.swap(hull);
+}
+
+// rotates a ccw polygon so that it starts at its bottom-most (then left-most) point
+static void rotateToBottom(vector<vec2> &points) {
+    size_t bottom = 0;
+    for (size_t c = 1; c < points.size(); c++) {
+        if (points[c].y < points[bottom].y || (points[c].y == points[bottom].y && points[c].x < points[bottom].x))
+            bottom = c;
+    }
+    rotate(points.begin(), points.begin() + bottom, points.end());
+}
+
+// merges the angle-sorted edges of two ccw convex polygons. Both must start at their bottom point.
+static void minkowskiSum(const vector<vec2> &a, const vector<vec2> &b, vector<vec2> &out) {
+    size_t n = a.size(), m = b.size();
+    size_t i = 0, j = 0;
+    out.clear();
+    out.reserve(n + m);
+    while (i < n || j < m) {
+        out.push_back(a[i % n] + b[j % m]);
+        vec2 edgeA = a[(i+1) % n] - a[i % n];
+        vec2 edgeB = b[(j+1) % m] - b[j % m];
+        float turn = cross(edgeA, edgeB);
+        if (turn == 0 && dot(edgeA, edgeB) < 0) {
+            // opposite edges, the one still in the upper half turn goes first
+            turn = edgeA.y > 0 || (edgeA.y == 0 && edgeA.x > 0) ? 1.f : -1.f;
+        }
+        if (j == m || (i < n && turn > 0)) {
+            i++;
+        } else if (i == n || turn < 0) {
+            j++;
+        } else { // parallel edges, take both at once
+            i++;
+            j++;
+        }
+    }
+}
+
+// distance from p to the segment ab
+static float segmentDistance(vec2 p, vec2 a, vec2 b) {
+    return length(closestOnSegment(a - p, b - p));
+}
+
+// greedily merges runs of vertices of a ccw hull that all lie within tolerance of the edge that skips them.
+static void simplifyHull(vector<vec2> &hull, float tolerance) {
+    size_t n = hull.size();
+    if (n <= 3) return;
+
+    vector<vec2> kept;
+    kept.reserve(n);
+    size_t anchor = 0;
+    kept.push_back(hull[0]);
+    while (anchor < n) {
+        // extend the edge from anchor as far as it stays within tolerance of every skipped vertex
+        size_t next = anchor + 1;
+        while (next < n) {
+            size_t candidate = next + 1;
+            vec2 end = hull[candidate % n];
+            bool fits = true;
+            for (size_t skipped = anchor + 1; skipped < candidate; skipped++) {
+                if (segmentDistance(hull[skipped], hull[anchor], end) > tolerance) {
+                    fits = false;
+                    break;
+                }
+            }
+            if (!fits) break;
+            next = candidate;
+        }
+        if (next >= n) break; // the edge closes the loop
+        kept.push_back(hull[next]);
+        anchor = next;
+    }
+
+    if (kept.size() >= 3) hull.swap(kept);
+}
+
+void PolygonCollider2D::buildHull(float tolerance) {
+    convexHull(points);
+    if (tolerance > 0) simplifyHull(points, tolerance);
+    markChanged();
+}
+
+// fills hull with the ccw bottom-first hull of collider, or returns false.
+static bool bakeHull(Collider2D *collider, vector<vec2> &hull, float epsilon) {
+    switch (collider->type) {
+        case COLLIDER_POLYGON: {
+            hull = static_cast<PolygonCollider2D *>(collider)->points;
+            if (hull.empty()) return false;
+            convexHull(hull);
+            break;
+        }
+        case COLLIDER_BOX: {
+            BoxCollider2D *box = static_cast<BoxCollider2D *>(collider);
+            hull.clear();
+            hull.push_back(box->center + vec2(-box->halfSize.x, -box->halfSize.y));
+            hull.push_back(box->center + vec2( box->halfSize.x, -box->halfSize.y));
+            hull.push_back(box->center + vec2( box->halfSize.x,  box->halfSize.y));
+            hull.push_back(box->center + vec2(-box->halfSize.x,  box->halfSize.y));
+            convexHull(hull); // handles zero sized boxes
+            break;
+        }
+        case COLLIDER_CIRCLE: {
+            CircleCollider2D *circle = static_cast<CircleCollider2D *>(collider);
+            hull.clear();
+            if (circle->radius <= 0) {
+                hull.push_back(circle->center);
+                break;
+            }
+            // Inscribed n-gon, with the sagitta of each edge no larger than epsilon.
+            // Capped before converting, since epsilon 0 asks for infinitely many and a negative one gives nan.
+            int sides = MAX_BAKED_SIDES;
+            if (epsilon >= circle->radius) {
+                sides = 3;
+            } else if (epsilon > 0) {
+                double needed = ceil(M_PI / acos(1 - double(epsilon) / circle->radius));
+                if (needed < MAX_BAKED_SIDES) sides = std::max(3, int(needed));
+            }
+            hull.reserve(sides);
+            for (int c = 0; c < sides; c++) {
+                float angle = float(2 * M_PI * c / sides - M_PI / 2);
+                hull.push_back(circle->center + circle->radius * vec2(cos(angle), sin(angle)));
+            }
+            break;
+        }
+        case COLLIDER_ADD:
+        case COLLIDER_SUB: {
+            bool add = collider->type == COLLIDER_ADD;
+            Collider2D *a = add ? static_cast<AddCollider2D *>(collider)->a : static_cast<SubCollider2D *>(collider)->a;
+            Collider2D *b = add ? static_cast<AddCollider2D *>(collider)->b : static_cast<SubCollider2D *>(collider)->b;
+            vector<vec2> hullA, hullB;
+            if (!bakeHull(a, hullA, epsilon) || !bakeHull(b, hullB, epsilon)) return false;
+            if (!add) {
+                for (vec2 &point : hullB) point = -point; // still ccw, but starts at the top now
+            }
+            rotateToBottom(hullB);
+            minkowskiSum(hullA, hullB, hull);
+            break;
+        }
+        default:
+            return false;
+    }
+    rotateToBottom(hull);
+    return true;
+}
+
+bool bakeMinkowski(Collider2D *collider, PolygonCollider2D &out, float epsilon) {
+    vector<vec2> hull;
+    if (!bakeHull(collider, hull, epsilon)) return false;
+    out.points.swap(hull);
+    return true;
+}
+
+struct BoundsNode {
+    vec2 point;
+    int next; // ccw neighbor
+};
+
+struct BoundsEdge {
+    float error; // how far the support point is outside the edge
+    int start;
+    vec2 support;
+    bool operator<(const BoundsEdge &other) const { return error < other.error; }
+};
+
+// queues the edge from nodes[start] to its neighbor if the surface strays more than epsilon outside of it
+static void queueEdge(Collider2D *collider, vector<BoundsNode> &nodes, vector<BoundsEdge> &edges, int start, float epsilon) {
+    vec2 right = nodes[start].point;
+    vec2 left = nodes[nodes[start].next].point;
+    vec2 edge = left - right; // the ccw direction around the shape
     vec2 out = vec2(edge.y, -edge.x); // the direction towards the unknown
     vec2 supp = collider->findSupport(out);
     if (supp == left || supp == right)
         return;
 
-    vec2 suppDir = supp - right;
-    float dist = abs(dot(suppDir, normalize(out)));
+    float dist = dot(supp - right, normalize(out));
     if (dist <= epsilon)
         return;
 
-    findBounds(collider, right, supp, bounds, epsilon);
-    bounds.push_back(supp);
-    findBounds(collider, supp, left, bounds, epsilon);
+    edges.push_back({dist, start, supp});
+    push_heap(edges.begin(), edges.end());
 }
 
-void findBounds(Collider2D *collider, vector<vec2> &bounds, float epsilon) {
-    vec2 top = collider->findSupport(vec2(0, 1));
-    vec2 bottom = collider->findSupport(vec2(0, -1));
-    if (top == bottom) {
-        bounds.push_back(top);
-        return;
+// Starts from the four axis extremes and keeps splitting whichever edge is furthest from the surface.
+// That puts the points where the curvature is, and keeps the error even if maxPoints cuts it short.
+// Uses a heap instead of recursion. Every point after the extremes costs two support queries, one for each
+// edge it makes, so the whole outline takes at most 4 + 2 * maxPoints of them.
+void findBounds(Collider2D *collider, vector<vec2> &bounds, float epsilon, size_t maxPoints) {
+    maxPoints = std::max(maxPoints, MIN_BOUNDS_POINTS); // the extremes always go in
+    vec2 extremes[4] = {
+        collider->findSupport(vec2( 0, 1)),
+        collider->findSupport(vec2(-1, 0)),
+        collider->findSupport(vec2( 0,-1)),
+        collider->findSupport(vec2( 1, 0)),
+    };
+
+    vector<BoundsNode> nodes;
+    vector<BoundsEdge> edges;
+    float extent = std::max(extremes[0].y - extremes[2].y, extremes[3].x - extremes[1].x) / 2;
+    size_t expected = 4;
+    if (epsilon > 0 && epsilon < extent) // the number of points a circle of this size would need
+        expected = size_t(ceil(M_PI / acos(1 - epsilon / extent)));
+    expected = std::min(std::max(expected, MIN_BOUNDS_POINTS), maxPoints);
+    nodes.reserve(expected);
+    edges.reserve(expected);
+
+    for (const vec2 &point : extremes) {
+        if (nodes.empty() || (point != nodes.back().point && point != nodes.front().point))
+            nodes.push_back({point, int(nodes.size()) + 1});
+    }
+    nodes.back().next = 0;
+
+    if (nodes.size() > 1) {
+        for (int c = 0, count = int(nodes.size()); c < count; c++) {
+            queueEdge(collider, nodes, edges, c, epsilon);
+        }
     }
 
-    bounds.push_back(top);
-    findBounds(collider, top, bottom, bounds, epsilon);
-    bounds.push_back(bottom);
-    findBounds(collider, bottom, top, bounds, epsilon);
+    while (!edges.empty() && nodes.size() < maxPoints) {
+        pop_heap(edges.begin(), edges.end());
+        BoundsEdge edge = edges.back();
+        edges.pop_back();
+
+        int split = int(nodes.size());
+        nodes.push_back({edge.support, nodes[edge.start].next});
+        nodes[edge.start].next = split;
+        queueEdge(collider, nodes, edges, edge.start, epsilon);
+        queueEdge(collider, nodes, edges, split, epsilon);
+    }
+
+    bounds.reserve(bounds.size() + nodes.size());
+    int c = 0;
+    do {
+        bounds.push_back(nodes[c].point);
+        c = nodes[c].next;
+    } while (c != 0);
+}
+
+static bool isPoint(Collider2D *collider) {
+    return collider->type == COLLIDER_POLYGON && static_cast<PolygonCollider2D *>(collider)->points.size() == 1;
+}
+
+// peels single point sums and differences off of collider, adding them to offset
+static Collider2D *stripTranslation(Collider2D *collider, vec2 &offset) {
+    while (true) {
+        if (collider->type == COLLIDER_ADD) {
+            AddCollider2D *add = static_cast<AddCollider2D *>(collider);
+            if (isPoint(add->b)) {
+                offset += static_cast<PolygonCollider2D *>(add->b)->points[0];
+                collider = add->a;
+                continue;
+            }
+            if (isPoint(add->a)) {
+                offset += static_cast<PolygonCollider2D *>(add->a)->points[0];
+                collider = add->b;
+                continue;
+            }
+        } else if (collider->type == COLLIDER_SUB) {
+            SubCollider2D *sub = static_cast<SubCollider2D *>(collider);
+            if (isPoint(sub->b)) {
+                offset -= static_cast<PolygonCollider2D *>(sub->b)->points[0];
+                collider = sub->a;
+                continue;
+            }
+        }
+        return collider;
+    }
+}
+
+static atomic<unsigned long long> nextCacheId(1);
+
+static unsigned long long cacheId(Collider2D *collider) {
+    if (!collider->cacheId) collider->cacheId = nextCacheId.fetch_add(1, memory_order_relaxed);
+    return collider->cacheId;
+}
+
+// appends the cacheId and version of every collider in the tree, parents before children
+static void treeKeys(Collider2D *collider, vector<pair<unsigned long long, unsigned>> &keys) {
+    keys.push_back(make_pair(cacheId(collider), collider->version));
+    if (collider->type == COLLIDER_ADD) {
+        treeKeys(static_cast<AddCollider2D *>(collider)->a, keys);
+        treeKeys(static_cast<AddCollider2D *>(collider)->b, keys);
+    } else if (collider->type == COLLIDER_SUB) {
+        treeKeys(static_cast<SubCollider2D *>(collider)->a, keys);
+        treeKeys(static_cast<SubCollider2D *>(collider)->b, keys);
+    }
+}
+
+void OutlineCache::findBounds(Collider2D *collider, vector<vec2> &bounds, float epsilon) {
+    vec2 offset(0, 0);
+    collider = stripTranslation(collider, offset);
+    tree.clear();
+    treeKeys(collider, tree);
+    unsigned long long id = tree[0].first;
+
+    Entry *entry = nullptr;
+    for (Entry &e : entries) {
+        if (e.id == id && e.epsilon == epsilon) {
+            entry = &e;
+            break;
+        }
+    }
+    if (!entry) {
+        if (entries.size() < std::max(maxEntries, size_t(1))) {
+            entries.emplace_back();
+            entry = &entries.back();
+        } else {
+            // reuses the least recently used entry, and its outline's memory
+            entry = &entries[0];
+            for (Entry &e : entries) {
+                if (e.lastUsed < entry->lastUsed) entry = &e;
+            }
+        }
+        entry->id = id;
+        entry->epsilon = epsilon;
+        entry->tree.clear(); // never matches, so it rebuilds
+    }
+    entry->lastUsed = ++uses;
+    if (entry->tree != tree) {
+        static PerfTag tessellateTag("Tessellate");
+        Perf stat(tessellateTag);
+        entry->outline.clear();
+        ::findBounds(collider, entry->outline, epsilon);
+        entry->tree.swap(tree);
+    }
+
+    bounds.reserve(bounds.size() + entry->outline.size());
+    for (const vec2 &point : entry->outline) {
+        bounds.push_back(point + offset);
+    }
+}
+
+void OutlineCache::clear() {
+    entries.clear();
 }
 
 bool intersects(Collider2D *a, Collider2D *b, vector<vec2> &points) {
@@ -72,13 +420,61 @@ bool intersects(Collider2D *a, Collider2D *b, vector<vec2> &points) {
     return containsOrigin(combined, points);
 }
 
-bool containsOrigin(SubCollider2D combined, vector<vec2> &points) {
-    Perf stat("GJK");
+enum GjkExit {
+    GJK_EXIT_FIRST_SUPPORT,
+    GJK_EXIT_SECOND_SUPPORT,
+    GJK_EXIT_LOOP,
+    GJK_EXIT_HIT
+};
+
+// Counts the work in one gjk query, and records it through Perf when the query returns.
+// Compiles to nothing unless GJK_TELEMETRY is defined.
+struct GjkTelemetry {
+#ifdef GJK_TELEMETRY
+    int supports = 0;
+    int iterations = 0;
+    GjkExit exitPath = GJK_EXIT_LOOP;
+
+    void support() { supports++; }
+    void iteration() { iterations++; }
+    bool exit(GjkExit path, bool result) {
+        exitPath = path;
+        return result;
+    }
+
+    ~GjkTelemetry() {
+        static PerfTag iterationsTag("GJK iterations");
+        static PerfTag supportsTag("GJK support calls");
+        static PerfTag exitTags[] = {
+            PerfTag("GJK exit: miss on first support"),
+            PerfTag("GJK exit: miss on second support"),
+            PerfTag("GJK exit: miss in loop"),
+            PerfTag("GJK exit: hit"),
+        };
+        recordPerformanceValue(iterationsTag, iterations);
+        recordPerformanceValue(supportsTag, supports);
+        recordPerformanceValue(exitTags[exitPath], iterations);
+    }
+#else
+    void support() {}
+    void iteration() {}
+    bool exit(GjkExit path, bool result) { return result; }
+#endif
+};
+
+// points is optional, and receives the triangles tested if present.
+static bool gjk(SubCollider2D &combined, vector<vec2> *points) {
+    // before stat, so it records after the timed scope closes instead of inside it
+    GjkTelemetry telemetry;
+    static PerfTag gjkTag("GJK");
+    Perf stat(gjkTag);
     vec2 surfA = combined.findSupport(vec2(0,1));
-    if (surfA.y <= 0) return false;
+    telemetry.support();
+    if (surfA.y <= 0) return telemetry.exit(GJK_EXIT_FIRST_SUPPORT, false);
 
     vec2 surfB = combined.findSupport(-surfA);
-    if (dot(-surfA, surfB) <= 0) return false;
+    telemetry.support();
+    if (dot(-surfA, surfB) <= 0) return telemetry.exit(GJK_EXIT_SECOND_SUPPORT, false);
 
     vec2 ab = surfB - surfA;
     vec2 out = vec2(ab.y, -ab.x);
@@ -89,12 +485,16 @@ bool containsOrigin(SubCollider2D combined, vector<vec2> &points) {
     }
 
     do {
+        telemetry.iteration();
         vec2 surfC = combined.findSupport(out);
-        if (dot(out, surfC) <= 0) return false;
+        telemetry.support();
+        if (dot(out, surfC) <= 0) return telemetry.exit(GJK_EXIT_LOOP, false);
 
-        points.push_back(surfA);
-        points.push_back(surfB);
-        points.push_back(surfC);
+        if (points) {
+            points->push_back(surfA);
+            points->push_back(surfB);
+            points->push_back(surfC);
+        }
 
         vec2 bc = surfC - surfB;
         vec2 bcOut = vec2(bc.y, -bc.x);
@@ -102,7 +502,7 @@ bool containsOrigin(SubCollider2D combined, vector<vec2> &points) {
             vec2 ca = surfA - surfC;
             vec2 caOut = vec2(ca.y, -ca.x);
             if (dot(caOut, surfC) > 0) {
-                return true; // inside triangle! Collision!
+                return telemetry.exit(GJK_EXIT_HIT, true); // inside triangle! Collision!
             } else {
                 out = caOut;
                 surfB = surfC;
@@ -113,3 +513,123 @@ bool containsOrigin(SubCollider2D combined, vector<vec2> &points) {
         }
     } while (true);
 }
+
+bool containsOrigin(SubCollider2D combined, vector<vec2> &points) {
+    return gjk(combined, &points);
+}
+
+// ---------------- pair kernels ----------------
+
+// squared distance from p to the convex hull of points, using gjk's distance iteration.
+// The simplex never has more than 3 points, and hits 0 if p is inside.
+static float distanceSqToHull(const vector<vec2> &points, vec2 p) {
+    if (points.empty()) return numeric_limits<float>::infinity();
+
+    vec2 simplex[3];
+    int count = 1;
+    simplex[0] = points[0] - p;
+    vec2 v = simplex[0];
+
+    for (size_t iter = 0; iter <= points.size() + 2; iter++) {
+        float vv = dot(v, v);
+        if (vv == 0) return 0;
+
+        // support of the translated hull in direction -v
+        float min_dot = numeric_limits<float>::infinity();
+        vec2 w;
+        for (const vec2 &point : points) {
+            float d = dot(v, point - p);
+            if (d < min_dot) {
+                min_dot = d;
+                w = point - p;
+            }
+        }
+        if (vv - min_dot <= vv * 1e-6f) return vv; // no progress, v is the closest point
+
+        simplex[count++] = w;
+        if (count == 2) {
+            v = closestOnSegment(simplex[0], simplex[1]);
+        } else {
+            vec2 a = simplex[0], b = simplex[1], c = simplex[2];
+            float abc = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+            float oab = a.x * b.y - a.y * b.x;
+            float obc = b.x * c.y - b.y * c.x;
+            float oca = c.x * a.y - c.y * a.x;
+            if (abc != 0 && (oab >= 0) == (abc > 0) && (obc >= 0) == (abc > 0) && (oca >= 0) == (abc > 0))
+                return 0; // inside triangle
+
+            // keep the edge closest to the origin. The newest point is always on it.
+            vec2 bc = closestOnSegment(b, c);
+            vec2 ca = closestOnSegment(c, a);
+            if (dot(bc, bc) <= dot(ca, ca)) {
+                simplex[0] = b;
+                simplex[1] = c;
+                v = bc;
+            } else {
+                simplex[0] = c;
+                simplex[1] = a;
+                v = ca;
+            }
+            count = 2;
+        }
+    }
+    return dot(v, v);
+}
+
+static bool generic(Collider2D *a, Collider2D *b) {
+    SubCollider2D combined;
+    combined.a = a;
+    combined.b = b;
+    return gjk(combined, nullptr);
+}
+
+// Touching counts as a miss in every kernel, like gjk, which only hits when the origin is strictly inside.
+// So each one hits only when the overlap is above 0. No Perf scopes here, they would cost more than the kernels.
+
+static bool circleCircle(Collider2D *a, Collider2D *b) {
+    CircleCollider2D *ca = static_cast<CircleCollider2D *>(a);
+    CircleCollider2D *cb = static_cast<CircleCollider2D *>(b);
+    vec2 d = cb->center - ca->center;
+    float r = ca->radius + cb->radius;
+    return r * r - dot(d, d) > 0;
+}
+
+static bool circlePolygon(Collider2D *a, Collider2D *b) {
+    CircleCollider2D *circle = static_cast<CircleCollider2D *>(a);
+    PolygonCollider2D *poly = static_cast<PolygonCollider2D *>(b);
+    return circle->radius * circle->radius - distanceSqToHull(poly->points, circle->center) > 0;
+}
+
+static bool circleBox(Collider2D *a, Collider2D *b) {
+    CircleCollider2D *circle = static_cast<CircleCollider2D *>(a);
+    BoxCollider2D *box = static_cast<BoxCollider2D *>(b);
+    vec2 closest = clamp(circle->center, box->center - box->halfSize, box->center + box->halfSize);
+    vec2 d = circle->center - closest;
+    return circle->radius * circle->radius - dot(d, d) > 0;
+}
+
+static bool boxBox(Collider2D *a, Collider2D *b) {
+    BoxCollider2D *ba = static_cast<BoxCollider2D *>(a);
+    BoxCollider2D *bb = static_cast<BoxCollider2D *>(b);
+    vec2 overlap = ba->halfSize + bb->halfSize - abs(bb->center - ba->center);
+    return overlap.x > 0 && overlap.y > 0;
+}
+
+// the kernels are symmetric, so the lower half of the table just swaps arguments.
+static bool polygonCircle(Collider2D *a, Collider2D *b) { return circlePolygon(b, a); }
+static bool boxCircle(Collider2D *a, Collider2D *b) { return circleBox(b, a); }
+
+typedef bool (*PairKernel)(Collider2D *a, Collider2D *b);
+
+static const PairKernel pairKernels[COLLIDER_TYPE_COUNT][COLLIDER_TYPE_COUNT] = {
+    //                 POLYGON        CIRCLE         BOX        ADD      SUB
+    /* POLYGON */   {  generic,       polygonCircle, generic,   generic, generic },
+    /* CIRCLE  */   {  circlePolygon, circleCircle,  circleBox, generic, generic },
+    /* BOX     */   {  generic,       boxCircle,     boxBox,    generic, generic },
+    /* ADD     */   {  generic,       generic,       generic,   generic, generic },
+    /* SUB     */   {  generic,       generic,       generic,   generic, generic },
+};
+
+bool collides(Collider2D *a, Collider2D *b) {
+    return pairKernels[a->type][b->type](a, b);
+}
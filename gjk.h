@@ -6,39 +6,139 @@
 #define COLISION2D_GJK_H
 
 #include <glm/glm.hpp>
+#include <utility>
 #include <vector>
 
+// used to dispatch pairs of colliders to specialized kernels. Keep COLLIDER_TYPE_COUNT last.
+enum ColliderType {
+    COLLIDER_POLYGON,
+    COLLIDER_CIRCLE,
+    COLLIDER_BOX,
+    COLLIDER_ADD,
+    COLLIDER_SUB,
+    COLLIDER_TYPE_COUNT
+};
+
 struct Collider2D {
+    ColliderType type;
+    unsigned version = 0; // bumped by markChanged, so caches know to rebuild
+    // Given out by OutlineCache the first time it sees this collider, and never reused, unlike the address.
+    // Copies start without one, since they can change apart from the original.
+    unsigned long long cacheId = 0;
+    explicit Collider2D(ColliderType type) : type(type) {}
+    virtual ~Collider2D() {} // scenes and tools own their colliders through base pointers
+    Collider2D(const Collider2D &other) : type(other.type), version(other.version) {}
+    Collider2D &operator=(const Collider2D &other) {
+        type = other.type;
+        version = other.version;
+        cacheId = 0;
+        return *this;
+    }
     virtual glm::vec2 findSupport(glm::vec2 direction) = 0;
+
+    // call after changing the shape, or the children of a sum or difference
+    void markChanged() { version++; }
 };
 
 struct AddCollider2D : public Collider2D {
     Collider2D *a;
     Collider2D *b;
+    AddCollider2D() : Collider2D(COLLIDER_ADD) {}
     glm::vec2 findSupport(glm::vec2 direction) override;
 };
 
 struct SubCollider2D : public Collider2D {
     Collider2D *a;
     Collider2D *b;
+    SubCollider2D() : Collider2D(COLLIDER_SUB) {}
     glm::vec2 findSupport(glm::vec2 direction) override;
 };
 
 struct PolygonCollider2D : public Collider2D {
     std::vector<glm::vec2> points;
+    PolygonCollider2D() : Collider2D(COLLIDER_POLYGON) {}
     glm::vec2 findSupport(glm::vec2 direction) override;
+
+    // Replaces points with their ccw convex hull, since interior points can never be support points.
+    // If tolerance is positive, also drops vertices that are within tolerance of the edge that would replace them.
+    // Marks the polygon changed.
+    void buildHull(float tolerance = 0);
 };
 
 struct CircleCollider2D : public Collider2D {
     glm::vec2 center;
     float radius;
+    CircleCollider2D() : Collider2D(COLLIDER_CIRCLE) {}
     glm::vec2 findSupport(glm::vec2 direction) override;
 };
 
-void findBounds(Collider2D *collider, std::vector<glm::vec2> &bounds, float epsilon);
+// axis aligned box
+struct BoxCollider2D : public Collider2D {
+    glm::vec2 center;
+    glm::vec2 halfSize;
+    BoxCollider2D() : Collider2D(COLLIDER_BOX) {}
+    glm::vec2 findSupport(glm::vec2 direction) override;
+};
+
+// the most sides bakeMinkowski gives a circle, however small epsilon is
+const int MAX_BAKED_SIDES = 4096;
+
+// Replaces a static tree of polygons, boxes, circles and their sums/differences with one exact convex polygon,
+// built by merging edge lists. Circles are sampled to within epsilon of their surface.
+// out receives the hull in ccw order. Returns false (and leaves out alone) if the tree can't be baked.
+// An epsilon of 0 or less bakes each circle with MAX_BAKED_SIDES sides.
+bool bakeMinkowski(Collider2D *collider, PolygonCollider2D &out, float epsilon);
+
+// the most points findBounds adds for one collider, however small epsilon is
+const size_t MAX_BOUNDS_POINTS = 4096;
+// findBounds always adds the collider's extremes along both axes, so a smaller maxPoints counts as this
+const size_t MIN_BOUNDS_POINTS = 4;
+
+// finds points on the collider's surface in ccw order, defining it to within epsilon of its mathematical definition.
+// Adds at most maxPoints points (at least MIN_BOUNDS_POINTS), spending them where the surface is furthest from the outline so far.
+void findBounds(Collider2D *collider, std::vector<glm::vec2> &bounds, float epsilon, size_t maxPoints = MAX_BOUNDS_POINTS);
+
+// the findBounds epsilon that keeps an outline within pixelError pixels when drawn at pixelsPerUnit
+inline float screenSpaceEpsilon(float pixelError, float pixelsPerUnit) {
+    return pixelError / pixelsPerUnit;
+}
+
+// Remembers the outlines found by findBounds, so unchanged shapes are only tessellated once.
+// Entries are keyed by the collider's cacheId and epsilon, and rebuilt when the id or version of anything in the tree changes.
+// A collider made at the address of a destroyed one gets a new id, so it can't pick up the old outline.
+// A sum or difference with a single point polygon is a translation, so it reuses the outline of the other side.
+// Holds at most maxEntries outlines, dropping the least recently used. Not thread safe.
+class OutlineCache {
+public:
+    explicit OutlineCache(size_t maxEntries = 256) : maxEntries(maxEntries) {}
+
+    // appends the outline of collider to bounds, like findBounds
+    void findBounds(Collider2D *collider, std::vector<glm::vec2> &bounds, float epsilon);
+    void clear();
+
+private:
+    // the cacheId and version of one collider in the tree
+    typedef std::pair<unsigned long long, unsigned> TreeKey;
+
+    struct Entry {
+        unsigned long long id;
+        float epsilon;
+        std::vector<TreeKey> tree; // every collider in the tree, in depth first order, when the outline was found
+        size_t lastUsed;
+        std::vector<glm::vec2> outline;
+    };
+    std::vector<Entry> entries;
+    std::vector<TreeKey> tree; // reused for the tree being looked up
+    size_t maxEntries;
+    size_t uses = 0;
+};
 
 bool intersects(Collider2D *a, Collider2D *b, std::vector<glm::vec2> &points);
 
 bool containsOrigin(SubCollider2D collider, std::vector<glm::vec2> &points);
 
+// same result as intersects, but picks a closed form kernel for the pair of types if there is one.
+// Falls back to gjk for anything else. Shapes that only touch don't collide, on either path.
+bool collides(Collider2D *a, Collider2D *b);
+
 #endif //COLISION2D_GJK_H
@@ -1,5 +1,7 @@
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
+#include <algorithm>
 
 #include <cmath>
 
@@ -7,7 +9,9 @@
 #include <stb/stb_image.h>
 #include "gl_includes.h"
 #include "Perf.h"
+#include "PerfStream.h"
 #include "gjk.h"
+#include "recording.h"
 
 using namespace std;
 using namespace glm;
@@ -18,6 +22,12 @@ void loadTexture(GLuint texname, const char *filename);
 GLFWwindow *window;
 
 const float scale = 128.f;
+const char *traceFile = "trace.json";
+const char *stacksFile = "stacks.folded";
+const char *worstFrameFile = "worst_frame.json";
+const char *samplesFile = "samples.folded";
+const double frameBudget = 1000.0 / 30; // mS, two missed vsyncs
+const float outlineEpsilon = screenSpaceEpsilon(0.5f, scale / 2); // scale covers two units of clip space
 
 const char *vertShader = GLSL(
     uniform vec2 inv;
@@ -57,7 +67,10 @@ AddCollider2D longCircle;
 
 PolygonCollider2D cursorPos;
 PolygonCollider2D cursorTriangle;
-AddCollider2D cursorCombined;
+SubCollider2D cursorDifference; // longCircle - cursorTriangle, static
+SubCollider2D cursorCombined; // cursorDifference - cursorPos, so the outline is a translation of cursorDifference's
+
+OutlineCache outlines;
 
 GLuint staticBuffer;
 GLuint debugBuffer;
@@ -67,6 +80,17 @@ vector<vec2> debugTris; // first bounds of combined collider, then triangles in
 int debugBoundsSize = 0; // number of points in bounds
 int debugTrigsSize = 0; // number of points in triangles
 
+// --record saves every input event here, tagged with the frame that polled it
+const char *recordFile = nullptr;
+vector<InputEvent> recordedInput;
+int frameNumber = 0;
+double recordStartTime = 0;
+
+// --play feeds these back on the frames they were recorded on, instead of taking real input
+bool playing = false;
+vector<InputEvent> playbackInput;
+vector<double> cursorLatencies; // seconds spent handling each played cursor event
+
 void setup() {
     glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
     glEnable(GL_DEPTH_TEST);
@@ -89,9 +113,16 @@ void setup() {
     cursorTriangle.points.emplace_back(0.2,-0.2);
     cursorTriangle.points.emplace_back(-0.5,-0.5);
 
+    // only hull points can be support points, so drop the rest up front
+    line.buildHull();
+    cursorTriangle.buildHull();
+
     cursorPos.points.emplace_back();
 
-    cursorCombined.a = &cursorTriangle;
+    cursorDifference.a = &longCircle;
+    cursorDifference.b = &cursorTriangle;
+
+    cursorCombined.a = &cursorDifference;
     cursorCombined.b = &cursorPos;
 
     vector<vec2> bounds;
@@ -102,11 +133,11 @@ void setup() {
     bounds.emplace_back( 0.25,-0.25);
 
     backStart = bounds.size();
-    findBounds(&longCircle, bounds, 0.01);
+    outlines.findBounds(&longCircle, bounds, outlineEpsilon);
     backSize = bounds.size() - backStart;
 
     cursorStart = bounds.size();
-    findBounds(&cursorTriangle, bounds, 0.01);
+    outlines.findBounds(&cursorTriangle, bounds, outlineEpsilon);
     cursorSize = bounds.size() - cursorStart;
 
     GLuint shader = compileShader(vertShader, fragShader);
@@ -173,7 +204,14 @@ static void glfw_resize_window_callback(GLFWwindow *window, int width, int heigh
     }
 }
 
-static void glfw_key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+static void recordInput(InputEvent event) {
+    if (!recordFile) return;
+    event.frame = frameNumber;
+    event.time = glfwGetTime() - recordStartTime;
+    recordedInput.push_back(event);
+}
+
+static void handleKey(int key, int scancode, int action, int mods) {
     if (action != GLFW_PRESS) return;
 
     if (key == GLFW_KEY_ESCAPE) {
@@ -182,46 +220,139 @@ static void glfw_key_callback(GLFWwindow* window, int key, int scancode, int act
         static bool wireframe = true;
         wireframe = !wireframe;
         glPolygonMode(GL_FRONT_AND_BACK, wireframe ? GL_LINE : GL_FILL);
+    } else if (key == GLFW_KEY_T) {
+        // t to start a trace, and again to save it
+        if (isPerformanceTraceRunning()) {
+            writePerformanceTrace(traceFile);
+        } else {
+            startPerformanceTrace(1 << 20);
+        }
+    } else if (key == GLFW_KEY_C) {
+        // c to toggle hardware counters
+        static bool counters = false;
+        counters = !counters;
+        setPerformanceCounters(counters);
+    } else if (key == GLFW_KEY_P) {
+        // p to toggle streaming to perfview
+        if (isPerformanceStreamRunning()) {
+            stopPerformanceStream();
+        } else {
+            startPerformanceStream(PERF_STREAM_DEFAULT_PATH);
+        }
+    } else if (key == GLFW_KEY_S) {
+        // s to start sampling, and again to stop and save the backtraces
+        static bool sampling = false;
+        sampling = !sampling;
+        if (sampling) {
+            startPerformanceSampling(1000, true);
+        } else {
+            stopPerformanceSampling();
+            writePerformanceSamples(samplesFile);
+        }
+    } else if (key == GLFW_KEY_X) {
+        // x to save every scope of the worst frame since the last report
+        writeWorstFrameTrace(worstFrameFile);
+    } else if (key == GLFW_KEY_F) {
+        // f to save a flame graph of everything since the last report
+        writePerformanceCollapsedStacks(stacksFile);
     }
 }
 
-static void glfw_click_callback(GLFWwindow *window, int button, int action, int mods) {
+static void handleClick(int button, int action, int mods, double x, double y, int sw, int sh) {
     if (action != GLFW_RELEASE) return;
 
-    double x, y;
-    glfwGetCursorPos(window, &x, &y);
-
-    int sw, sh;
-    glfwGetWindowSize(window, &sw, &sh);
-
     float cx = 2 * (float(x) - float(sw) / 2) / scale;
     float cy = 2 * -(float(y) - float(sh) / 2) / scale;
 
     printf("Mouse at (%f,%f)\n", cx, cy);
 }
 
-static void glfw_mouse_move_callback(GLFWwindow *window, double x, double y) {
-    int sw, sh;
-    glfwGetWindowSize(window, &sw, &sh);
-    int fw, fh;
-    glfwGetFramebufferSize(window, &fw, &fh);
+static void handleCursor(double x, double y, int sw, int sh) {
+    static PerfTag cursorTag("Cursor moved");
+    Perf stat(cursorTag);
 
     float cx = 2 * (float(x) - float(sw) / 2) / scale;
     float cy = 2 * -(float(y) - float(sh) / 2) / scale;
 
     cursorPos.points.back() = vec2(cx, cy);
 
-    SubCollider2D combined;
-    combined.a = &longCircle;
-    combined.b = &cursorCombined;
-
     debugTris.clear();
-    findBounds(&combined, debugTris, 0.01);
+    outlines.findBounds(&cursorCombined, debugTris, outlineEpsilon);
     debugBoundsSize = debugTris.size();
-    colliding = containsOrigin(combined, debugTris);
+    colliding = containsOrigin(cursorCombined, debugTris);
     debugTrigsSize = debugTris.size() - debugBoundsSize;
 }
 
+static void glfw_key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    if (playing) {
+        // only escape gets through during playback
+        if (key == GLFW_KEY_ESCAPE) glfwSetWindowShouldClose(window, true);
+        return;
+    }
+    InputEvent event;
+    event.kind = INPUT_KEY;
+    event.code = key;
+    event.scancode = scancode;
+    event.action = action;
+    event.mods = mods;
+    recordInput(event);
+    handleKey(key, scancode, action, mods);
+}
+
+static void glfw_click_callback(GLFWwindow *window, int button, int action, int mods) {
+    if (playing) return;
+    InputEvent event;
+    event.kind = INPUT_BUTTON;
+    event.code = button;
+    event.action = action;
+    event.mods = mods;
+    glfwGetCursorPos(window, &event.x, &event.y);
+    glfwGetWindowSize(window, &event.width, &event.height);
+    recordInput(event);
+    handleClick(button, action, mods, event.x, event.y, event.width, event.height);
+}
+
+static void glfw_mouse_move_callback(GLFWwindow *window, double x, double y) {
+    if (playing) return;
+    InputEvent event;
+    event.kind = INPUT_CURSOR;
+    event.x = x;
+    event.y = y;
+    glfwGetWindowSize(window, &event.width, &event.height);
+    recordInput(event);
+    handleCursor(x, y, event.width, event.height);
+}
+
+// Hands the events recorded on this frame to the same handlers live input goes to.
+// Returns false once everything has been played.
+static bool playInput(size_t &next) {
+    static PerfTag playInputTag("Play input");
+    Perf stat(playInputTag);
+    while (next < playbackInput.size() && playbackInput[next].frame <= frameNumber) {
+        const InputEvent &event = playbackInput[next++];
+        if (event.kind == INPUT_CURSOR) {
+            double start = glfwGetTime();
+            handleCursor(event.x, event.y, event.width, event.height);
+            cursorLatencies.push_back(glfwGetTime() - start);
+        } else if (event.kind == INPUT_KEY) {
+            handleKey(event.code, event.scancode, event.action, event.mods);
+        } else {
+            handleClick(event.code, event.action, event.mods, event.x, event.y, event.width, event.height);
+        }
+    }
+    return next < playbackInput.size();
+}
+
+static void printDistribution(const char *name, vector<double> values) {
+    if (values.empty()) return;
+    sort(values.begin(), values.end());
+    double total = 0;
+    for (double value : values) total += value;
+    size_t p99 = std::min(values.size() - 1, values.size() * 99 / 100);
+    printf("%-16s %8zu  mean %9.1fuS  p50 %9.1fuS  p99 %9.1fuS  max %9.1fuS\n", name, values.size(),
+           total / values.size() * 1e6, values[values.size() / 2] * 1e6, values[p99] * 1e6, values.back() * 1e6);
+}
+
 void glfw_error_callback(int error, const char* description) {
     cerr << "GLFW Error: " << description << " (error " << error << ")" << endl;
 }
@@ -321,7 +452,29 @@ void loadTexture(GLuint texname, const char *filename) {
     stbi_image_free(pixels);
 }
 
-int main() {
+// usage: Collision2D [--record file] [--play file]
+// --play runs the recording as fast as it can with vsync off, then prints frame and cursor handling times.
+int main(int argc, char **argv) {
+    const char *playFile = nullptr;
+    for (int c = 1; c < argc; c++) {
+        if (!strcmp(argv[c], "--record") && c + 1 < argc) {
+            recordFile = argv[++c];
+        } else if (!strcmp(argv[c], "--play") && c + 1 < argc) {
+            playFile = argv[++c];
+        } else {
+            cout << "usage: Collision2D [--record file] [--play file]" << endl;
+            return 2;
+        }
+    }
+    if (playFile) {
+        if (!readInputRecording(playFile, playbackInput)) {
+            cout << "Failed to read input recording " << playFile << endl;
+            return 1;
+        }
+        playing = true;
+        cursorLatencies.reserve(playbackInput.size());
+    }
+
     if (!glfwInit()) {
         cout << "Failed to init GLFW" << endl;
         exit(-1);
@@ -348,9 +501,11 @@ int main() {
     glfwMakeContextCurrent(window);
     glewInit();
 
-    glfwSwapInterval(1);
+    // vsync would hide any change in the frame time
+    glfwSwapInterval(playing ? 0 : 1);
 
     initPerformanceData();
+    setPerformanceFrameBudget(frameBudget);
 
     setup();
     checkError();
@@ -363,36 +518,77 @@ int main() {
     glfwGetWindowSize(window, &width, &height);
     glfw_resize_window_callback(window, width, height); // call resize once with the initial size
 
+    // the recorded cursor is relative to the recorded window, so draw at that size too
+    for (const InputEvent &event : playbackInput) {
+        if (event.width > 0 && event.height > 0) {
+            glfwSetWindowSize(window, event.width, event.height);
+            break;
+        }
+    }
+
     // make sure performance data is clean going into main loop
     markPerformanceFrame();
     printPerformanceData();
     double lastPerfPrintTime = glfwGetTime();
-    while (!glfwWindowShouldClose(window)) {
+    recordStartTime = lastPerfPrintTime;
+    size_t nextInput = 0;
+    bool playedAll = false;
+    vector<double> frameTimes;
+    frameTimes.reserve(playbackInput.empty() ? 0 : playbackInput.back().frame + 1);
+    while (!glfwWindowShouldClose(window) && !playedAll) {
+        double frameStart = glfwGetTime();
 
         {
-            Perf stat("Poll events");
+            static PerfTag pollEventsTag("Poll events");
+            Perf stat(pollEventsTag);
             glfwPollEvents();
             checkError();
         }
+        if (playing) {
+            playedAll = !playInput(nextInput);
+        }
         {
-            Perf stat("Draw");
+            static PerfTag drawTag("Draw");
+            Perf stat(drawTag);
             draw();
             checkError();
         }
         {
-            Perf stat("Swap buffers");
+            static PerfTag swapBuffersTag("Swap buffers");
+            Perf stat(swapBuffersTag);
             glfwSwapBuffers(window);
             checkError();
         }
 
         markPerformanceFrame();
+        frameNumber++;
 
         double now = glfwGetTime();
+        if (playing) {
+            frameTimes.push_back(now - frameStart);
+        }
         if (now - lastPerfPrintTime > 10.0) {
             printPerformanceData();
             lastPerfPrintTime = now;
         }
     }
 
+    if (isPerformanceTraceRunning()) {
+        writePerformanceTrace(traceFile);
+    }
+    if (recordFile) {
+        if (writeInputRecording(recordFile, recordedInput)) {
+            cout << "Recorded " << recordedInput.size() << " events over " << frameNumber << " frames to " << recordFile << endl;
+        } else {
+            cout << "Failed to write input recording " << recordFile << endl;
+        }
+    }
+    if (playing) {
+        printf("Played %zu of %zu events over %d frames\n", nextInput, playbackInput.size(), frameNumber);
+        printDistribution("frame", frameTimes);
+        printDistribution("cursor moved", cursorLatencies);
+        printPerformanceData();
+    }
+
     return 0;
 }
@@ -0,0 +1,65 @@
+#include "recording.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+static const char *VERSION_LINE = "collision2d input 1";
+
+bool writeInputRecording(const char *filename, const vector<InputEvent> &events) {
+    FILE *file = fopen(filename, "w");
+    if (!file) return false;
+    fprintf(file, "%s\n", VERSION_LINE);
+    for (const InputEvent &event : events) {
+        fprintf(file, "%d %.6f ", event.frame, event.time);
+        switch (event.kind) {
+            case INPUT_CURSOR:
+                fprintf(file, "cursor %.17g %.17g %d %d\n", event.x, event.y, event.width, event.height);
+                break;
+            case INPUT_KEY:
+                fprintf(file, "key %d %d %d %d\n", event.code, event.scancode, event.action, event.mods);
+                break;
+            case INPUT_BUTTON:
+                fprintf(file, "button %d %d %d %.17g %.17g %d %d\n", event.code, event.action, event.mods,
+                        event.x, event.y, event.width, event.height);
+                break;
+        }
+    }
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+bool readInputRecording(const char *filename, vector<InputEvent> &events) {
+    FILE *file = fopen(filename, "r");
+    if (!file) return false;
+    char line[256];
+    bool ok = fgets(line, sizeof(line), file) && strncmp(line, VERSION_LINE, strlen(VERSION_LINE)) == 0;
+    while (ok && fgets(line, sizeof(line), file)) {
+        InputEvent event;
+        char kind[16];
+        int used = 0;
+        if (sscanf(line, "%d %lf %15s %n", &event.frame, &event.time, kind, &used) < 3) {
+            ok = line[strspn(line, " \t\r\n")] == 0; // blank lines are fine
+            continue;
+        }
+        const char *rest = line + used;
+        if (!strcmp(kind, "cursor")) {
+            event.kind = INPUT_CURSOR;
+            ok = sscanf(rest, "%lf %lf %d %d", &event.x, &event.y, &event.width, &event.height) == 4;
+        } else if (!strcmp(kind, "key")) {
+            event.kind = INPUT_KEY;
+            ok = sscanf(rest, "%d %d %d %d", &event.code, &event.scancode, &event.action, &event.mods) == 4;
+        } else if (!strcmp(kind, "button")) {
+            event.kind = INPUT_BUTTON;
+            ok = sscanf(rest, "%d %d %d %lf %lf %d %d", &event.code, &event.action, &event.mods,
+                        &event.x, &event.y, &event.width, &event.height) == 7;
+        } else {
+            ok = false;
+        }
+        if (ok) events.push_back(event);
+    }
+    fclose(file);
+    return ok;
+}
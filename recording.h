@@ -0,0 +1,34 @@
+// Input for the demo, saved so a session can be played back exactly, frame by frame.
+// One event per line, after a version line:
+//   frame seconds cursor x y windowWidth windowHeight
+//   frame seconds key key scancode action mods
+//   frame seconds button button action mods x y windowWidth windowHeight
+
+#ifndef COLLISION2D_RECORDING_H
+#define COLLISION2D_RECORDING_H
+
+#include <vector>
+
+enum InputKind {
+    INPUT_CURSOR,
+    INPUT_KEY,
+    INPUT_BUTTON
+};
+
+struct InputEvent {
+    int frame; // the frame whose poll delivered it, from 0
+    double time; // seconds since recording started
+    InputKind kind;
+    int code = 0; // key or mouse button
+    int scancode = 0;
+    int action = 0;
+    int mods = 0;
+    double x = 0, y = 0; // cursor, in window coordinates
+    int width = 0, height = 0; // of the window, which the cursor is relative to
+};
+
+bool writeInputRecording(const char *filename, const std::vector<InputEvent> &events);
+// events come back in the order they were recorded
+bool readInputRecording(const char *filename, std::vector<InputEvent> &events);
+
+#endif //COLLISION2D_RECORDING_H
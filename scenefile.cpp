@@ -0,0 +1,256 @@
+#include "scenefile.h"
+#include "broadphase.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+using namespace glm;
+using namespace std;
+
+static const int MAX_SHAPE_DEPTH = 64; // sums and differences nested deeper than this are surely a broken file
+
+// whitespace separated words, with comments dropped
+class SceneTokens {
+public:
+    explicit SceneTokens(istream &in) {
+        string line;
+        while (getline(in, line)) {
+            text += line.substr(0, line.find('#'));
+            text += '\n';
+        }
+        words.str(text);
+    }
+
+    bool word(string &out) {
+        return bool(words >> out);
+    }
+
+    bool number(float &out) {
+        string token;
+        if (!(words >> token)) return false;
+        char *end;
+        out = strtof(token.c_str(), &end);
+        return *end == 0 && end != token.c_str() && std::isfinite(out);
+    }
+
+    bool count(int &out) {
+        float value;
+        if (!number(value) || value < 0 || value != floor(value) || value > 1e7f) return false;
+        out = int(value);
+        return true;
+    }
+
+private:
+    string text;
+    istringstream words;
+};
+
+template<class T>
+static T *addShape(vector<unique_ptr<Collider2D>> &shapes) {
+    T *shape = new T();
+    shapes.emplace_back(shape);
+    return shape;
+}
+
+static vec2 turn(vec2 point, vec2 rotation) {
+    return vec2(point.x * rotation.x - point.y * rotation.y, point.x * rotation.y + point.y * rotation.x);
+}
+
+// Reads a shape in the body's frame and turns it. Turning distributes over sums and differences,
+// so every leaf turns the same way.
+static Collider2D *readShape(SceneTokens &tokens, vector<unique_ptr<Collider2D>> &shapes, vec2 rotation, int depth, string &error) {
+    string kind;
+    if (!tokens.word(kind)) {
+        error = "expected a shape";
+        return nullptr;
+    }
+    if (kind == "circle") {
+        float x, y, radius;
+        if (!tokens.number(x) || !tokens.number(y) || !tokens.number(radius) || radius < 0) {
+            error = "a circle needs a center and a radius";
+            return nullptr;
+        }
+        CircleCollider2D *circle = addShape<CircleCollider2D>(shapes);
+        circle->center = turn(vec2(x, y), rotation);
+        circle->radius = radius;
+        return circle;
+    }
+    if (kind == "box") {
+        float x, y, halfWidth, halfHeight;
+        if (!tokens.number(x) || !tokens.number(y) || !tokens.number(halfWidth) || !tokens.number(halfHeight)) {
+            error = "a box needs a center and a half size";
+            return nullptr;
+        }
+        vec2 center(x, y), half(std::abs(halfWidth), std::abs(halfHeight));
+        if (rotation == vec2(1, 0)) {
+            BoxCollider2D *box = addShape<BoxCollider2D>(shapes);
+            box->center = center;
+            box->halfSize = half;
+            return box;
+        }
+        PolygonCollider2D *polygon = addShape<PolygonCollider2D>(shapes);
+        polygon->points.push_back(turn(center + vec2(-half.x, -half.y), rotation));
+        polygon->points.push_back(turn(center + vec2( half.x, -half.y), rotation));
+        polygon->points.push_back(turn(center + vec2( half.x,  half.y), rotation));
+        polygon->points.push_back(turn(center + vec2(-half.x,  half.y), rotation));
+        polygon->buildHull();
+        return polygon;
+    }
+    if (kind == "polygon") {
+        int count;
+        if (!tokens.count(count) || count == 0) {
+            error = "a polygon needs a vertex count";
+            return nullptr;
+        }
+        PolygonCollider2D *polygon = addShape<PolygonCollider2D>(shapes);
+        for (int c = 0; c < count; c++) {
+            float x, y;
+            if (!tokens.number(x) || !tokens.number(y)) {
+                error = "a polygon has fewer vertices than its count";
+                return nullptr;
+            }
+            polygon->points.push_back(turn(vec2(x, y), rotation));
+        }
+        polygon->buildHull();
+        return polygon;
+    }
+    if (kind == "add" || kind == "sub") {
+        if (depth >= MAX_SHAPE_DEPTH) {
+            error = "shapes are nested too deeply";
+            return nullptr;
+        }
+        Collider2D *a = readShape(tokens, shapes, rotation, depth + 1, error);
+        if (!a) return nullptr;
+        Collider2D *b = readShape(tokens, shapes, rotation, depth + 1, error);
+        if (!b) return nullptr;
+        if (kind == "add") {
+            AddCollider2D *sum = addShape<AddCollider2D>(shapes);
+            sum->a = a;
+            sum->b = b;
+            return sum;
+        }
+        SubCollider2D *difference = addShape<SubCollider2D>(shapes);
+        difference->a = a;
+        difference->b = b;
+        return difference;
+    }
+    error = "unknown shape '" + kind + "'";
+    return nullptr;
+}
+
+bool readScene(const char *filename, Scene &scene, string *error) {
+    string problem;
+    ifstream file(filename);
+    if (!file) {
+        if (error) *error = string("couldn't open ") + filename;
+        return false;
+    }
+    SceneTokens tokens(file);
+
+    scene.bodies.clear();
+    scene.shapes.clear();
+    scene.motion = MOTION_DRIFT;
+    scene.speed = 0;
+    scene.size = vec2(0, 0);
+
+    string magic, kind, version;
+    if (!tokens.word(magic) || !tokens.word(kind) || !tokens.word(version) ||
+        magic != "collision2d" || kind != "scene" || version != "1") {
+        if (error) *error = "not a collision2d scene 1 file";
+        return false;
+    }
+
+    string word;
+    while (tokens.word(word)) {
+        if (word != "body") {
+            problem = "expected 'body', not '" + word + "'";
+            break;
+        }
+        SceneBody body;
+        float x, y, angle, vx, vy;
+        if (!tokens.number(x) || !tokens.number(y) || !tokens.number(angle) || !tokens.number(vx) || !tokens.number(vy)) {
+            problem = "a body needs a position, an angle and a velocity";
+            break;
+        }
+        vec2 rotation = angle == 0 ? vec2(1, 0) : vec2(cos(angle), sin(angle));
+        body.collider = readShape(tokens, scene.shapes, rotation, 0, problem);
+        if (!body.collider) break;
+
+        body.position = vec2(x, y);
+        body.anchor = body.position;
+        body.velocity = vec2(vx, vy);
+        translateCollider(body.collider, body.position);
+        Aabb box = findAabb(body.collider);
+        body.radius = length(glm::max(glm::abs(box.min - body.position), glm::abs(box.max - body.position)));
+        scene.size = glm::max(scene.size, body.position);
+        scene.bodies.push_back(body);
+    }
+
+    if (!problem.empty()) {
+        if (error) *error = "body " + to_string(scene.bodies.size() + 1) + ": " + problem;
+        scene.bodies.clear();
+        scene.shapes.clear();
+        return false;
+    }
+    return true;
+}
+
+// translateCollider only moves the first side of a sum or difference, so only that side is taken back to the body
+static void writeShape(FILE *file, Collider2D *collider, vec2 offset) {
+    switch (collider->type) {
+        case COLLIDER_POLYGON: {
+            PolygonCollider2D *polygon = static_cast<PolygonCollider2D *>(collider);
+            fprintf(file, "polygon %d", int(polygon->points.size()));
+            for (vec2 point : polygon->points) {
+                fprintf(file, " %.9g %.9g", point.x + offset.x, point.y + offset.y);
+            }
+            break;
+        }
+        case COLLIDER_CIRCLE: {
+            CircleCollider2D *circle = static_cast<CircleCollider2D *>(collider);
+            fprintf(file, "circle %.9g %.9g %.9g", circle->center.x + offset.x, circle->center.y + offset.y, circle->radius);
+            break;
+        }
+        case COLLIDER_BOX: {
+            BoxCollider2D *box = static_cast<BoxCollider2D *>(collider);
+            fprintf(file, "box %.9g %.9g %.9g %.9g", box->center.x + offset.x, box->center.y + offset.y,
+                    box->halfSize.x, box->halfSize.y);
+            break;
+        }
+        case COLLIDER_ADD: {
+            AddCollider2D *sum = static_cast<AddCollider2D *>(collider);
+            fprintf(file, "add ");
+            writeShape(file, sum->a, offset);
+            fprintf(file, " ");
+            writeShape(file, sum->b, vec2(0, 0));
+            break;
+        }
+        case COLLIDER_SUB: {
+            SubCollider2D *difference = static_cast<SubCollider2D *>(collider);
+            fprintf(file, "sub ");
+            writeShape(file, difference->a, offset);
+            fprintf(file, " ");
+            writeShape(file, difference->b, vec2(0, 0));
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+bool writeScene(const char *filename, const Scene &scene) {
+    FILE *file = fopen(filename, "w");
+    if (!file) return false;
+    fprintf(file, "collision2d scene 1\n# body x y angle vx vy shape\n");
+    for (const SceneBody &body : scene.bodies) {
+        fprintf(file, "body %.9g %.9g 0 %.9g %.9g ", body.position.x, body.position.y, body.velocity.x, body.velocity.y);
+        writeShape(file, body.collider, -body.position);
+        fprintf(file, "\n");
+    }
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
@@ -0,0 +1,25 @@
+// Scenes as text, so scenes captured elsewhere can be stepped offline. '#' starts a comment,
+// and any whitespace separates values. After a "collision2d scene 1" line, each body is
+//   body x y angle vx vy shape
+// with the shape in the body's frame, turned by angle (radians) and then moved to x, y:
+//   circle cx cy radius
+//   box cx cy halfWidth halfHeight
+//   polygon n x1 y1 ... xn yn
+//   add shape shape
+//   sub shape shape
+// Boxes are axis aligned, so a turned box is read as a polygon.
+
+#ifndef COLLISION2D_SCENEFILE_H
+#define COLLISION2D_SCENEFILE_H
+
+#include <string>
+
+#include "scenegen.h"
+
+// Replaces everything in scene with the bodies in filename, drifting at their velocities.
+// On failure, says what was wrong in error if it's given.
+bool readScene(const char *filename, Scene &scene, std::string *error = nullptr);
+// writes the bodies where they are now, unturned
+bool writeScene(const char *filename, const Scene &scene);
+
+#endif //COLLISION2D_SCENEFILE_H
@@ -0,0 +1,233 @@
+#include "scenegen.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace glm;
+using namespace std;
+
+static float randomFloat(mt19937 &rng, float lo, float hi) {
+    return uniform_real_distribution<float>(lo, hi)(rng);
+}
+
+static int randomInt(mt19937 &rng, int lo, int hi) {
+    return uniform_int_distribution<int>(lo, std::max(lo, hi))(rng);
+}
+
+template<class T>
+static T *addShape(vector<unique_ptr<Collider2D>> &shapes) {
+    T *shape = new T();
+    shapes.emplace_back(shape);
+    return shape;
+}
+
+static CircleCollider2D *addCircle(vector<unique_ptr<Collider2D>> &shapes, vec2 center, float radius) {
+    CircleCollider2D *circle = addShape<CircleCollider2D>(shapes);
+    circle->center = center;
+    circle->radius = radius;
+    return circle;
+}
+
+// Vertices at sorted random angles on a circle are always convex, and stay convex when the circle
+// is squashed into an ellipse and turned. Keeps the angles apart so no two vertices merge.
+static PolygonCollider2D *addPolygon(vector<unique_ptr<Collider2D>> &shapes, mt19937 &rng, int vertices, vec2 center, float radius) {
+    PolygonCollider2D *polygon = addShape<PolygonCollider2D>(shapes);
+    vertices = std::max(vertices, 3);
+    float step = 2 * float(M_PI) / vertices;
+    float start = randomFloat(rng, 0, 2 * float(M_PI));
+    float squash = randomFloat(rng, 0.5f, 1);
+    float turn = randomFloat(rng, 0, 2 * float(M_PI));
+    vec2 u(cos(turn), sin(turn));
+    vec2 v(-u.y, u.x);
+    for (int c = 0; c < vertices; c++) {
+        float angle = start + (c + randomFloat(rng, -0.4f, 0.4f)) * step;
+        vec2 local(cos(angle), squash * sin(angle));
+        polygon->points.push_back(center + radius * (local.x * u + local.y * v));
+    }
+    polygon->buildHull();
+    polygon->points.shrink_to_fit();
+    return polygon;
+}
+
+template<class T>
+static T *addPair(vector<unique_ptr<Collider2D>> &shapes, Collider2D *a, Collider2D *b) {
+    T *pair = addShape<T>(shapes);
+    pair->a = a;
+    pair->b = b;
+    return pair;
+}
+
+static Collider2D *addBody(vector<unique_ptr<Collider2D>> &shapes, mt19937 &rng, const SceneSettings &settings,
+                           SceneShape shape, vec2 center, float radius) {
+    switch (shape) {
+        case SCENE_CIRCLE:
+            return addCircle(shapes, center, radius);
+        case SCENE_POLYGON:
+            return addPolygon(shapes, rng, randomInt(rng, settings.minVertices, settings.maxVertices), center, radius);
+        case SCENE_CAPSULE: {
+            float half = radius * randomFloat(rng, 0.3f, 0.7f);
+            float angle = randomFloat(rng, 0, 2 * float(M_PI));
+            vec2 axis = half * vec2(cos(angle), sin(angle));
+            PolygonCollider2D *segment = addShape<PolygonCollider2D>(shapes);
+            segment->points.push_back(center - axis);
+            segment->points.push_back(center + axis);
+            return addPair<AddCollider2D>(shapes, segment, addCircle(shapes, vec2(0, 0), radius - half));
+        }
+        case SCENE_BOX: {
+            // the corners stay on the bounding circle
+            float angle = randomFloat(rng, 0.2f, float(M_PI) / 2 - 0.2f);
+            BoxCollider2D *box = addShape<BoxCollider2D>(shapes);
+            box->center = center;
+            box->halfSize = radius * vec2(cos(angle), sin(angle));
+            return box;
+        }
+        default: {
+            int vertices = randomInt(rng, settings.minVertices, settings.maxVertices);
+            Collider2D *polygon = addPolygon(shapes, rng, vertices, center, 0.6f * radius);
+            Collider2D *other;
+            if (rng() % 2) {
+                other = addCircle(shapes, vec2(0, 0), 0.4f * radius);
+            } else {
+                other = addPolygon(shapes, rng, randomInt(rng, settings.minVertices, settings.maxVertices), vec2(0, 0), 0.4f * radius);
+            }
+            return addPair<AddCollider2D>(shapes, polygon, other);
+        }
+    }
+}
+
+static SceneShape pickShape(mt19937 &rng, const SceneSettings &settings) {
+    float total = 0;
+    for (float weight : settings.shapeWeights) total += std::max(weight, 0.f);
+    if (total <= 0) return SCENE_CIRCLE;
+    float pick = randomFloat(rng, 0, total);
+    for (int c = 0; c < SCENE_SHAPE_COUNT; c++) {
+        pick -= std::max(settings.shapeWeights[c], 0.f);
+        if (pick < 0) return SceneShape(c);
+    }
+    return SceneShape(SCENE_SHAPE_COUNT - 1);
+}
+
+void generateScene(const SceneSettings &settings, Scene &scene) {
+    mt19937 rng(settings.seed);
+    scene.bodies.clear();
+    scene.shapes.clear();
+    scene.motion = settings.motion;
+    scene.speed = settings.speed;
+    scene.rng.seed(settings.seed ^ 0x9e3779b9u);
+    if (settings.bodies <= 0) {
+        scene.size = vec2(0, 0);
+        return;
+    }
+
+    // radii first, since the size of the scene depends on them
+    vector<float> radii;
+    double sum = 0, sumSquares = 0;
+    for (int c = 0; c < settings.bodies; c++) {
+        float t = pow(randomFloat(rng, 0, 1), settings.sizeSkew);
+        float radius = settings.minRadius + (settings.maxRadius - settings.minRadius) * t;
+        radii.push_back(radius);
+        sum += radius;
+        sumSquares += double(radius) * radius;
+    }
+    // two circles overlap when their centers are closer than the sum of their radii
+    double mean = sum / settings.bodies, meanSquare = sumSquares / settings.bodies;
+    double area = M_PI * (2 * meanSquare + 2 * mean * mean) * (settings.bodies - 1) / std::max(settings.overlap, 1e-3f);
+    float side = float(sqrt(std::max(area, 1.0)));
+    scene.size = vec2(side, side);
+
+    vector<vec2> clusters;
+    if (settings.clusterSize > 0) {
+        for (int c = 0; c < (settings.bodies + settings.clusterSize - 1) / settings.clusterSize; c++) {
+            clusters.push_back(vec2(randomFloat(rng, 0, side), randomFloat(rng, 0, side)));
+        }
+    }
+    normal_distribution<float> spread(0, settings.clusterSpread);
+
+    scene.bodies.reserve(settings.bodies);
+    for (int c = 0; c < settings.bodies; c++) {
+        SceneBody body;
+        if (clusters.empty()) {
+            body.position = vec2(randomFloat(rng, 0, side), randomFloat(rng, 0, side));
+            body.anchor = body.position + vec2(randomFloat(rng, -2, 2), randomFloat(rng, -2, 2));
+        } else {
+            body.anchor = clusters[c / settings.clusterSize];
+            body.position = body.anchor + vec2(spread(rng), spread(rng));
+        }
+        body.radius = radii[c];
+        float heading = randomFloat(rng, 0, 2 * float(M_PI));
+        body.velocity = settings.speed * vec2(cos(heading), sin(heading));
+        body.collider = addBody(scene.shapes, rng, settings, pickShape(rng, settings), body.position, body.radius);
+        scene.bodies.push_back(body);
+    }
+}
+
+void translateCollider(Collider2D *collider, vec2 offset) {
+    switch (collider->type) {
+        case COLLIDER_POLYGON:
+            for (vec2 &point : static_cast<PolygonCollider2D *>(collider)->points) point += offset;
+            break;
+        case COLLIDER_CIRCLE:
+            static_cast<CircleCollider2D *>(collider)->center += offset;
+            break;
+        case COLLIDER_BOX:
+            static_cast<BoxCollider2D *>(collider)->center += offset;
+            break;
+        case COLLIDER_ADD:
+            translateCollider(static_cast<AddCollider2D *>(collider)->a, offset);
+            break;
+        case COLLIDER_SUB:
+            translateCollider(static_cast<SubCollider2D *>(collider)->a, offset);
+            break;
+        default:
+            return;
+    }
+    collider->markChanged();
+}
+
+void Scene::step(float dt) {
+    if (motion == MOTION_NONE) return;
+    for (SceneBody &body : bodies) {
+        vec2 next = body.position;
+        if (motion == MOTION_DRIFT) {
+            next += dt * body.velocity;
+        } else if (motion == MOTION_LINEAR) {
+            next += dt * body.velocity;
+            for (int axis = 0; axis < 2; axis++) {
+                if ((next[axis] < 0 && body.velocity[axis] < 0) || (next[axis] > size[axis] && body.velocity[axis] > 0)) {
+                    body.velocity[axis] = -body.velocity[axis];
+                }
+            }
+        } else if (motion == MOTION_ORBIT) {
+            vec2 arm = body.position - body.anchor;
+            float distance = length(arm);
+            if (distance > 0) {
+                float angle = speed * dt / distance;
+                vec2 turn(cos(angle), sin(angle));
+                next = body.anchor + vec2(arm.x * turn.x - arm.y * turn.y, arm.x * turn.y + arm.y * turn.x);
+            }
+        } else {
+            float heading = randomFloat(rng, 0, 2 * float(M_PI));
+            body.velocity = 0.9f * body.velocity + 0.1f * speed * vec2(cos(heading), sin(heading));
+            next += dt * body.velocity;
+        }
+        translateCollider(body.collider, next - body.position);
+        body.position = next;
+    }
+}
+
+size_t Scene::bytes() const {
+    size_t total = bodies.capacity() * sizeof(SceneBody) + shapes.capacity() * sizeof(unique_ptr<Collider2D>);
+    for (const unique_ptr<Collider2D> &shape : shapes) {
+        switch (shape->type) {
+            case COLLIDER_POLYGON:
+                total += sizeof(PolygonCollider2D) + static_cast<PolygonCollider2D *>(shape.get())->points.capacity() * sizeof(vec2);
+                break;
+            case COLLIDER_CIRCLE: total += sizeof(CircleCollider2D); break;
+            case COLLIDER_BOX: total += sizeof(BoxCollider2D); break;
+            case COLLIDER_ADD: total += sizeof(AddCollider2D); break;
+            case COLLIDER_SUB: total += sizeof(SubCollider2D); break;
+            default: break;
+        }
+    }
+    return total;
+}
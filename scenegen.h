@@ -0,0 +1,92 @@
+#ifndef COLLISION2D_SCENEGEN_H
+#define COLLISION2D_SCENEGEN_H
+
+#include <glm/glm.hpp>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gjk.h"
+
+// the kinds of body a scene can hold
+enum SceneShape {
+    SCENE_CIRCLE,
+    SCENE_POLYGON,   // convex, with exactly the vertex count asked for
+    SCENE_CAPSULE,   // a segment plus a circle
+    SCENE_COMPOSITE, // a polygon plus a circle or another polygon
+    SCENE_BOX,       // axis aligned
+    SCENE_SHAPE_COUNT
+};
+
+enum SceneMotion {
+    MOTION_NONE,
+    MOTION_LINEAR, // constant velocity, bouncing off the edges of the scene
+    MOTION_ORBIT,  // circling the body's cluster, or where it started if there are no clusters
+    MOTION_JITTER, // a random walk
+    MOTION_DRIFT   // constant velocity with no edges, for scenes read from a file
+};
+
+struct SceneSettings {
+    unsigned seed = 1;
+    int bodies = 1000;
+
+    // relative chance of each shape
+    float shapeWeights[SCENE_SHAPE_COUNT] = {1, 1, 0, 0, 0};
+    // for polygons, and the polygon parts of composites
+    int minVertices = 3;
+    int maxVertices = 8;
+
+    // Every body fits in a circle of a radius between these.
+    // sizeSkew above 1 makes small bodies more common, so a few big ones stand out.
+    float minRadius = 0.5f;
+    float maxRadius = 0.5f;
+    float sizeSkew = 1;
+
+    // Each body's bounding circle overlaps this many others on average, if they're spread evenly.
+    // Sets the size of the scene.
+    float overlap = 0.8f;
+    // bodies per cluster, 0 to spread them evenly. Clustering raises the overlap.
+    int clusterSize = 0;
+    float clusterSpread = 2; // standard deviation of a cluster, in units
+
+    SceneMotion motion = MOTION_NONE;
+    float speed = 1; // units per second
+};
+
+struct SceneBody {
+    Collider2D *collider; // in scene coordinates
+    glm::vec2 position;
+    glm::vec2 velocity;
+    glm::vec2 anchor; // what MOTION_ORBIT circles
+    float radius; // of a circle around position that holds the whole body
+};
+
+// A generated world. Owns its colliders. The same settings always make the same scene.
+class Scene {
+public:
+    std::vector<SceneBody> bodies;
+    glm::vec2 size; // bodies start in [0, size]. For a scene read from a file, the largest position.
+
+    // moves every body by its motion, and marks the shapes that moved as changed
+    void step(float dt);
+    // what the colliders and their points take up
+    size_t bytes() const;
+
+private:
+    friend void generateScene(const SceneSettings &settings, Scene &scene);
+    friend bool readScene(const char *filename, Scene &scene, std::string *error);
+    std::vector<std::unique_ptr<Collider2D>> shapes; // bodies and their parts
+    SceneMotion motion = MOTION_NONE;
+    float speed = 0;
+    std::mt19937 rng;
+};
+
+// replaces everything in scene with a new world from settings
+void generateScene(const SceneSettings &settings, Scene &scene);
+
+// Moves a collider made of polygons, circles, boxes and sums by offset.
+// Only one side of a sum needs moving, and a difference moves with its first side.
+void translateCollider(Collider2D *collider, glm::vec2 offset);
+
+#endif //COLLISION2D_SCENEGEN_H
@@ -0,0 +1,601 @@
+// Runs seeded random pairs through collides, intersects and containsOrigin, and checks each one against
+// a slow reference: sums are built from every pair of vertices, circles are sampled densely,
+// and the two hulls are tested against every axis that could separate them.
+// First checks that bakeMinkowski gives a sane circle at epsilons of 0 and below, and that every path calls
+// touching shapes a miss.
+// usage: difftest [--count n] [--seed s] [--circle-points n] [--tolerance t] [--report n]
+// Every check builds and frees its colliders, so run it from a COLLISION2D_SANITIZE build now and then to catch leaks.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gjk.h"
+#include "scenegen.h"
+
+using namespace glm;
+using namespace std;
+
+typedef dvec2 Point;
+
+// A collider tree by value, so reproductions can be pulled apart while minimizing.
+struct Shape {
+    ColliderType type;
+    vector<vec2> points; // polygon
+    vec2 center; // circle and box
+    vec2 halfSize;
+    float radius = 0;
+    vector<Shape> children; // sum and difference
+};
+
+// the colliders built from a Shape, kept alive together
+struct Built {
+    vector<unique_ptr<Collider2D>> owned;
+    Collider2D *root = nullptr;
+};
+
+int circlePoints = 256;
+double tolerance = 1e-4; // relative to the size of the pair
+
+static Shape toShape(Collider2D *collider) {
+    Shape shape;
+    shape.type = collider->type;
+    switch (collider->type) {
+        case COLLIDER_POLYGON:
+            shape.points = static_cast<PolygonCollider2D *>(collider)->points;
+            break;
+        case COLLIDER_CIRCLE:
+            shape.center = static_cast<CircleCollider2D *>(collider)->center;
+            shape.radius = static_cast<CircleCollider2D *>(collider)->radius;
+            break;
+        case COLLIDER_BOX:
+            shape.center = static_cast<BoxCollider2D *>(collider)->center;
+            shape.halfSize = static_cast<BoxCollider2D *>(collider)->halfSize;
+            break;
+        case COLLIDER_ADD:
+            shape.children.push_back(toShape(static_cast<AddCollider2D *>(collider)->a));
+            shape.children.push_back(toShape(static_cast<AddCollider2D *>(collider)->b));
+            break;
+        case COLLIDER_SUB:
+            shape.children.push_back(toShape(static_cast<SubCollider2D *>(collider)->a));
+            shape.children.push_back(toShape(static_cast<SubCollider2D *>(collider)->b));
+            break;
+        default:
+            break;
+    }
+    return shape;
+}
+
+static Collider2D *build(const Shape &shape, Built &built) {
+    Collider2D *collider = nullptr;
+    switch (shape.type) {
+        case COLLIDER_POLYGON: {
+            PolygonCollider2D *polygon = new PolygonCollider2D();
+            polygon->points = shape.points;
+            collider = polygon;
+            break;
+        }
+        case COLLIDER_CIRCLE: {
+            CircleCollider2D *circle = new CircleCollider2D();
+            circle->center = shape.center;
+            circle->radius = shape.radius;
+            collider = circle;
+            break;
+        }
+        case COLLIDER_BOX: {
+            BoxCollider2D *box = new BoxCollider2D();
+            box->center = shape.center;
+            box->halfSize = shape.halfSize;
+            collider = box;
+            break;
+        }
+        case COLLIDER_ADD: {
+            AddCollider2D *add = new AddCollider2D();
+            add->a = build(shape.children[0], built);
+            add->b = build(shape.children[1], built);
+            collider = add;
+            break;
+        }
+        default: {
+            SubCollider2D *sub = new SubCollider2D();
+            sub->a = build(shape.children[0], built);
+            sub->b = build(shape.children[1], built);
+            collider = sub;
+            break;
+        }
+    }
+    built.owned.emplace_back(collider);
+    built.root = collider;
+    return collider;
+}
+
+// ---------------- reference ----------------
+
+static double cross(Point o, Point a, Point b) {
+    return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+
+// monotone chain in doubles, ccw, without collinear points. Fewer than three points are left alone.
+static vector<Point> hull(vector<Point> points) {
+    sort(points.begin(), points.end(), [](const Point &a, const Point &b) {
+        return a.x < b.x || (a.x == b.x && a.y < b.y);
+    });
+    points.erase(unique(points.begin(), points.end()), points.end());
+    if (points.size() < 3) return points;
+    vector<Point> out(2 * points.size());
+    size_t k = 0;
+    for (size_t c = 0; c < points.size(); c++) {
+        while (k >= 2 && cross(out[k - 2], out[k - 1], points[c]) <= 0) k--;
+        out[k++] = points[c];
+    }
+    for (size_t c = points.size() - 1, lower = k + 1; c > 0; c--) {
+        while (k >= lower && cross(out[k - 2], out[k - 1], points[c - 1]) <= 0) k--;
+        out[k++] = points[c - 1];
+    }
+    out.resize(k - 1);
+    return out;
+}
+
+// the hull of every sum of a point of a and a point of b (or difference, if sign is -1)
+static vector<Point> sumAll(const vector<Point> &a, const vector<Point> &b, double sign) {
+    vector<Point> out;
+    for (const Point &p : a) {
+        for (const Point &q : b) {
+            out.push_back(p + sign * q);
+        }
+    }
+    return hull(out);
+}
+
+// the hull of the shape, with circles as many sided polygons.
+// Adds how far inside the true surface the sampling can be to error.
+static vector<Point> referencePoints(const Shape &shape, double &error) {
+    vector<Point> points;
+    switch (shape.type) {
+        case COLLIDER_POLYGON:
+            for (const vec2 &point : shape.points) points.push_back(Point(point));
+            return hull(points);
+        case COLLIDER_CIRCLE:
+            for (int c = 0; c < circlePoints; c++) {
+                double angle = 2 * M_PI * c / circlePoints;
+                points.push_back(Point(shape.center) + double(shape.radius) * Point(cos(angle), sin(angle)));
+            }
+            error += shape.radius * (1 - cos(M_PI / circlePoints));
+            return hull(points);
+        case COLLIDER_BOX: {
+            Point c(shape.center), h(shape.halfSize);
+            points.push_back(c + Point(-h.x, -h.y));
+            points.push_back(c + Point( h.x, -h.y));
+            points.push_back(c + Point( h.x,  h.y));
+            points.push_back(c + Point(-h.x,  h.y));
+            return hull(points);
+        }
+        case COLLIDER_ADD:
+            return sumAll(referencePoints(shape.children[0], error), referencePoints(shape.children[1], error), 1);
+        default:
+            return sumAll(referencePoints(shape.children[0], error), referencePoints(shape.children[1], error), -1);
+    }
+}
+
+static double segmentDistance(Point p, Point a, Point b) {
+    Point ab = b - a;
+    double len2 = dot(ab, ab);
+    double t = len2 > 0 ? clamp(dot(p - a, ab) / len2, 0.0, 1.0) : 0;
+    return length(p - (a + t * ab));
+}
+
+enum Verdict {
+    MISS,
+    HIT,
+    TOO_CLOSE // within the tolerance of touching, so either answer is fine
+};
+
+// the range of a convex point set along axis
+static void project(const vector<Point> &points, Point axis, double &lo, double &hi) {
+    lo = numeric_limits<double>::infinity();
+    hi = -lo;
+    for (const Point &p : points) {
+        double d = dot(p, axis);
+        lo = std::min(lo, d);
+        hi = std::max(hi, d);
+    }
+}
+
+// every edge normal, plus the directions of segments and the line between the centers,
+// so that points and segments get a separating axis too
+static void addAxes(const vector<Point> &hull, vector<Point> &axes) {
+    for (size_t c = 0; c < hull.size(); c++) {
+        Point edge = hull[(c + 1) % hull.size()] - hull[c];
+        if (edge == Point(0, 0)) continue;
+        axes.push_back(normalize(Point(edge.y, -edge.x)));
+        if (hull.size() == 2) axes.push_back(normalize(edge));
+    }
+}
+
+static Point centroid(const vector<Point> &points) {
+    Point sum(0, 0);
+    for (const Point &p : points) sum += p;
+    return sum / double(points.size());
+}
+
+// closest distance between two convex point sets that don't overlap, from every vertex to every edge
+static double separation(const vector<Point> &a, const vector<Point> &b) {
+    double distance = numeric_limits<double>::infinity();
+    for (size_t c = 0; c < a.size(); c++) {
+        for (size_t d = 0; d < b.size(); d++) {
+            distance = std::min(distance, segmentDistance(a[c], b[d], b[(d + 1) % b.size()]));
+            distance = std::min(distance, segmentDistance(b[d], a[c], a[(c + 1) % a.size()]));
+        }
+    }
+    return distance;
+}
+
+// Whether a and b overlap, by the separating axis theorem on their hulls.
+// Overlap is the same as the origin being inside a - b.
+static Verdict reference(const Shape &a, const Shape &b) {
+    double error = 0;
+    vector<Point> hullA = referencePoints(a, error);
+    vector<Point> hullB = referencePoints(b, error);
+    if (hullA.empty() || hullB.empty()) return MISS;
+
+    double scale = 1;
+    for (const vector<Point> *points : {&hullA, &hullB}) {
+        for (const Point &p : *points) scale = std::max(scale, std::max(fabs(p.x), fabs(p.y)));
+    }
+    double margin = error + tolerance * scale;
+
+    vector<Point> axes;
+    addAxes(hullA, axes);
+    addAxes(hullB, axes);
+    Point between = centroid(hullB) - centroid(hullA);
+    if (between != Point(0, 0)) axes.push_back(normalize(between));
+
+    double depth = numeric_limits<double>::infinity();
+    for (const Point &axis : axes) {
+        double loA, hiA, loB, hiB;
+        project(hullA, axis, loA, hiA);
+        project(hullB, axis, loB, hiB);
+        double overlap = std::min(hiA, hiB) - std::max(loA, loB);
+        if (overlap < 0) {
+            return separation(hullA, hullB) <= margin ? TOO_CLOSE : MISS;
+        }
+        depth = std::min(depth, overlap);
+    }
+    return depth <= margin ? TOO_CLOSE : HIT;
+}
+
+// ---------------- checking ----------------
+
+enum Path {
+    PATH_COLLIDES,
+    PATH_INTERSECTS,
+    PATH_CONTAINS_ORIGIN,
+    PATH_COUNT
+};
+
+static const char *pathNames[PATH_COUNT] = {"collides", "intersects", "containsOrigin"};
+
+// which paths disagree with the reference, as bits. -1 if the reference can't tell.
+static int check(const Shape &a, const Shape &b) {
+    Verdict expected = reference(a, b);
+    if (expected == TOO_CLOSE) return -1;
+
+    Built builtA, builtB;
+    Collider2D *ca = build(a, builtA);
+    Collider2D *cb = build(b, builtB);
+    vector<vec2> points;
+    bool results[PATH_COUNT];
+    results[PATH_COLLIDES] = collides(ca, cb);
+    results[PATH_INTERSECTS] = intersects(ca, cb, points);
+    SubCollider2D combined;
+    combined.a = ca;
+    combined.b = cb;
+    points.clear();
+    results[PATH_CONTAINS_ORIGIN] = containsOrigin(combined, points);
+
+    int mismatches = 0;
+    for (int c = 0; c < PATH_COUNT; c++) {
+        if (results[c] != (expected == HIT)) mismatches |= 1 << c;
+    }
+    return mismatches;
+}
+
+static void simplerShapes(const Shape &shape, vector<Shape> &out) {
+    if (shape.type == COLLIDER_ADD || shape.type == COLLIDER_SUB) {
+        out.push_back(shape.children[0]);
+        out.push_back(shape.children[1]);
+        for (int side = 0; side < 2; side++) {
+            vector<Shape> children;
+            simplerShapes(shape.children[side], children);
+            for (const Shape &child : children) {
+                Shape copy = shape;
+                copy.children[side] = child;
+                out.push_back(copy);
+            }
+        }
+    } else if (shape.type == COLLIDER_POLYGON && shape.points.size() > 1) {
+        for (size_t c = 0; c < shape.points.size(); c++) {
+            Shape copy = shape;
+            copy.points.erase(copy.points.begin() + c);
+            out.push_back(copy);
+        }
+    }
+}
+
+static float roundTo(float value, float step) {
+    return float(floor(value / step + 0.5) * step);
+}
+
+static Shape rounded(Shape shape, float step) {
+    for (vec2 &point : shape.points) point = vec2(roundTo(point.x, step), roundTo(point.y, step));
+    shape.center = vec2(roundTo(shape.center.x, step), roundTo(shape.center.y, step));
+    shape.halfSize = vec2(roundTo(shape.halfSize.x, step), roundTo(shape.halfSize.y, step));
+    shape.radius = roundTo(shape.radius, step);
+    for (Shape &child : shape.children) child = rounded(child, step);
+    return shape;
+}
+
+// readable, and exact enough to rebuild the same floats
+static string describe(const Shape &shape) {
+    char buffer[128];
+    string out;
+    switch (shape.type) {
+        case COLLIDER_POLYGON:
+            out = "polygon[";
+            for (size_t c = 0; c < shape.points.size(); c++) {
+                snprintf(buffer, sizeof(buffer), "%s(%.9g, %.9g)", c ? ", " : "", shape.points[c].x, shape.points[c].y);
+                out += buffer;
+            }
+            return out + "]";
+        case COLLIDER_CIRCLE:
+            snprintf(buffer, sizeof(buffer), "circle(center (%.9g, %.9g), radius %.9g)", shape.center.x, shape.center.y, shape.radius);
+            return buffer;
+        case COLLIDER_BOX:
+            snprintf(buffer, sizeof(buffer), "box(center (%.9g, %.9g), half (%.9g, %.9g))",
+                     shape.center.x, shape.center.y, shape.halfSize.x, shape.halfSize.y);
+            return buffer;
+        default:
+            return string(shape.type == COLLIDER_ADD ? "add(" : "sub(") +
+                   describe(shape.children[0]) + ", " + describe(shape.children[1]) + ")";
+    }
+}
+
+// whether the pair fails at least one of the same paths, and can still be judged by the reference
+static bool stillFails(const Shape &a, const Shape &b, int &mismatches) {
+    int result = check(a, b);
+    if (result <= 0 || !(result & mismatches)) return false;
+    mismatches &= result;
+    return true;
+}
+
+// Greedily drops parts of the pair while it still fails the same way
+static void simplify(Shape &a, Shape &b, int &mismatches) {
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        vector<Shape> simpler;
+        simplerShapes(a, simpler);
+        for (const Shape &shape : simpler) {
+            if (stillFails(shape, b, mismatches)) {
+                a = shape;
+                progress = true;
+                break;
+            }
+        }
+        if (progress) continue;
+        simpler.clear();
+        simplerShapes(b, simpler);
+        for (const Shape &shape : simpler) {
+            if (stillFails(a, shape, mismatches)) {
+                b = shape;
+                progress = true;
+                break;
+            }
+        }
+    }
+}
+
+// Simplifies, rounds to the coarsest grid that still fails, then simplifies again.
+// Rounding is only tried once, since floats don't round to a grid exactly and could go back and forth.
+static void minimize(Shape &a, Shape &b, int mismatches) {
+    simplify(a, b, mismatches);
+    for (float step : {1.f, 0.5f, 0.1f, 0.01f, 0.001f}) {
+        Shape roundA = rounded(a, step), roundB = rounded(b, step);
+        if (stillFails(roundA, roundB, mismatches)) {
+            a = roundA;
+            b = roundB;
+            simplify(a, b, mismatches);
+            break;
+        }
+    }
+}
+
+// Bakes a circle at epsilons findBounds never passes in. Returns the number that came out wrong.
+static int checkBakeEpsilons() {
+    CircleCollider2D circle;
+    circle.center = vec2(1, 2);
+    circle.radius = 3;
+    PolygonCollider2D fine;
+    bakeMinkowski(&circle, fine, 1e-4f);
+    int failures = 0;
+    for (float epsilon : {0.f, -0.f, -1.f, 1e-30f, NAN, 1e-4f, 3.f, 100.f}) {
+        PolygonCollider2D baked;
+        bool ok = bakeMinkowski(&circle, baked, epsilon);
+        // anything finer than 1e-4 has to come out at least as fine
+        size_t least = epsilon <= 1e-4f || std::isnan(epsilon) ? fine.points.size() : 3;
+        ok = ok && baked.points.size() >= least && baked.points.size() <= size_t(MAX_BAKED_SIDES);
+        for (size_t c = 0; ok && c < baked.points.size(); c++) {
+            ok = fabs(length(baked.points[c] - circle.center) - circle.radius) < 1e-4f;
+        }
+        if (!ok) {
+            printf("bakeMinkowski of a circle at epsilon %g: %d points, wrong count or not on the circle\n", epsilon, int(baked.points.size()));
+            failures++;
+        }
+    }
+    return failures;
+}
+
+static Shape circleShape(vec2 center, float radius) {
+    Shape shape;
+    shape.type = COLLIDER_CIRCLE;
+    shape.center = center;
+    shape.radius = radius;
+    return shape;
+}
+
+static Shape boxShape(vec2 center, vec2 halfSize) {
+    Shape shape;
+    shape.type = COLLIDER_BOX;
+    shape.center = center;
+    shape.halfSize = halfSize;
+    return shape;
+}
+
+static Shape polygonShape(vector<vec2> points) {
+    Shape shape;
+    shape.type = COLLIDER_POLYGON;
+    shape.points = points;
+    return shape;
+}
+
+static Shape moved(Shape shape, vec2 offset) {
+    for (vec2 &point : shape.points) point += offset;
+    shape.center += offset;
+    for (Shape &child : shape.children) child = moved(child, offset);
+    return shape;
+}
+
+// Pairs that touch exactly, for every kernel and for gjk. They have to miss on every path, then hit once
+// b is pushed in a little. Circles only touch along an axis, since their support points anywhere else
+// are rounded and gjk could go either way. Returns the number of paths that came out wrong.
+static int checkTouching() {
+    Shape square = polygonShape({vec2(-1, -1), vec2(1, -1), vec2(1, 1), vec2(-1, 1)});
+    Shape triangle = polygonShape({vec2(-1, -1), vec2(1, -1), vec2(0, 1)});
+    struct Touching {
+        const char *name;
+        Shape a, b;
+        vec2 push; // moves b into a
+    } pairs[] = {
+        {"circle-circle", circleShape(vec2(0, 0), 1), circleShape(vec2(2, 0), 1), vec2(-0.25f, 0)},
+        {"circle-circle", circleShape(vec2(0, 0), 1), circleShape(vec2(0, -3), 2), vec2(0, 0.25f)},
+        {"circle-box", circleShape(vec2(0, 2), 1), boxShape(vec2(0, 0), vec2(1, 1)), vec2(0, 0.25f)},
+        {"circle-box", circleShape(vec2(-2, 0.5f), 1), boxShape(vec2(0, 0), vec2(1, 1)), vec2(-0.25f, 0)},
+        {"circle-polygon", circleShape(vec2(2, 0), 1), square, vec2(0.25f, 0)},
+        {"circle-polygon", circleShape(vec2(0, 2), 1), triangle, vec2(0, 0.25f)},
+        {"box-box", boxShape(vec2(0, 0), vec2(1, 1)), boxShape(vec2(2, 0.5f), vec2(1, 1)), vec2(-0.25f, 0)},
+        {"box-box", boxShape(vec2(0, 0), vec2(1, 1)), boxShape(vec2(2, 2), vec2(1, 1)), vec2(-0.25f, -0.25f)},
+        {"box-polygon", boxShape(vec2(0, 2), vec2(2, 1)), triangle, vec2(0, 0.25f)},
+        {"polygon-polygon", square, moved(square, vec2(0, -2)), vec2(0, 0.25f)},
+    };
+    int failures = 0;
+    for (const Touching &pair : pairs) {
+        for (int pushed = 0; pushed < 2; pushed++) {
+            Shape b = pushed ? moved(pair.b, pair.push) : pair.b;
+            for (int swapped = 0; swapped < 2; swapped++) {
+                Built builtA, builtB;
+                Collider2D *ca = build(swapped ? b : pair.a, builtA);
+                Collider2D *cb = build(swapped ? pair.a : b, builtB);
+                vector<vec2> points;
+                bool results[PATH_COUNT];
+                results[PATH_COLLIDES] = collides(ca, cb);
+                results[PATH_INTERSECTS] = intersects(ca, cb, points);
+                SubCollider2D combined;
+                combined.a = ca;
+                combined.b = cb;
+                results[PATH_CONTAINS_ORIGIN] = containsOrigin(combined, points);
+                for (int c = 0; c < PATH_COUNT; c++) {
+                    if (results[c] == bool(pushed)) continue;
+                    printf("%s %s%s: %s says %s\n", pair.name, pushed ? "overlapping" : "touching",
+                           swapped ? ", swapped" : "", pathNames[c], results[c] ? "hit" : "miss");
+                    failures++;
+                }
+            }
+        }
+    }
+    return failures;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: difftest [--count n] [--seed s] [--circle-points n] [--tolerance t] [--report n]\n");
+}
+
+int main(int argc, char **argv) {
+    long long count = 1000000;
+    unsigned seed = 1;
+    int report = 10;
+    for (int c = 1; c < argc; c++) {
+        bool hasValue = c + 1 < argc;
+        if (!strcmp(argv[c], "--count") && hasValue) {
+            count = atoll(argv[++c]);
+        } else if (!strcmp(argv[c], "--seed") && hasValue) {
+            seed = unsigned(strtoul(argv[++c], nullptr, 0));
+        } else if (!strcmp(argv[c], "--circle-points") && hasValue) {
+            circlePoints = std::max(8, atoi(argv[++c]));
+        } else if (!strcmp(argv[c], "--tolerance") && hasValue) {
+            tolerance = atof(argv[++c]);
+        } else if (!strcmp(argv[c], "--report") && hasValue) {
+            report = atoi(argv[++c]);
+        } else {
+            usage();
+            return 2;
+        }
+    }
+
+    int bakeFailures = checkBakeEpsilons();
+    int touchingFailures = checkTouching();
+
+    // two bodies sized so about half of the pairs touch
+    SceneSettings settings;
+    settings.bodies = 2;
+    for (float &weight : settings.shapeWeights) weight = 1;
+    settings.minVertices = 3;
+    settings.maxVertices = 12;
+    settings.minRadius = 0.1f;
+    settings.maxRadius = 3;
+    settings.sizeSkew = 2;
+    settings.overlap = 0.5f;
+
+    long long tooClose = 0, failed = 0;
+    long long mismatches[PATH_COUNT] = {};
+    Scene scene;
+    for (long long trial = 0; trial < count; trial++) {
+        settings.seed = seed + unsigned(trial);
+        generateScene(settings, scene);
+        Shape a = toShape(scene.bodies[0].collider);
+        Shape b = toShape(scene.bodies[1].collider);
+
+        int result = check(a, b);
+        if (result < 0) {
+            tooClose++;
+            continue;
+        }
+        if (!result) continue;
+
+        failed++;
+        for (int c = 0; c < PATH_COUNT; c++) {
+            if (result & (1 << c)) mismatches[c]++;
+        }
+        if (failed <= report) {
+            Verdict expected = reference(a, b);
+            minimize(a, b, result);
+            printf("seed %u: reference says %s, wrong:", settings.seed, expected == HIT ? "hit" : "miss");
+            for (int c = 0; c < PATH_COUNT; c++) {
+                if (result & (1 << c)) printf(" %s", pathNames[c]);
+            }
+            printf("\n  minimized, reference says %s:\n  a = %s\n  b = %s\n",
+                   reference(a, b) == HIT ? "hit" : "miss", describe(a).c_str(), describe(b).c_str());
+        }
+    }
+
+    printf("%lld pairs, %lld too close to call, %lld mismatched", count, tooClose, failed);
+    for (int c = 0; c < PATH_COUNT; c++) {
+        printf(", %s %lld", pathNames[c], mismatches[c]);
+    }
+    printf("\n");
+    return failed || bakeFailures || touchingFailures ? 1 : 0;
+}
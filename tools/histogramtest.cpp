@@ -0,0 +1,57 @@
+// Checks the percentiles Perf reports from its histograms: small values have to come back exact,
+// large ones within a bucket, and ones past the top have to land in the last bucket.
+// usage: histogramtest
+
+#include <cmath>
+#include <cstdio>
+
+#include "PerfHistogram.h"
+
+// the percentile that lands on the rank'th smallest of count values
+static double percentileOfRank(int rank, int count) {
+    return (rank + 0.5) * 100 / count;
+}
+
+static int check(bool ok, const char *what, double got, double expected) {
+    if (ok) return 0;
+    printf("%s: got %.1f, expected %.1f\n", what, got, expected);
+    return 1;
+}
+
+int main() {
+    int failures = 0;
+
+    // 0 through 63 each get their own bucket, then one value just past 2^39
+    Histogram histogram;
+    const int exact = 2 * Histogram::SUB_COUNT;
+    const unsigned long long large = (1ULL << 39) + 1;
+    for (int c = 0; c < exact; c++) histogram.record(c);
+    histogram.record(large);
+    int count = exact + 1;
+    for (int c = 0; c < exact; c++) {
+        double got = histogram.percentile(percentileOfRank(c, count));
+        char what[64];
+        snprintf(what, sizeof(what), "percentile of rank %d", c);
+        failures += check(got == c, what, got, c);
+    }
+    double top = histogram.percentile(100);
+    failures += check(fabs(top - double(large)) <= double(large) / Histogram::SUB_COUNT, "2^39 + 1", top, double(large));
+    failures += check(Histogram::bucketOf(large) < Histogram::BUCKETS - 1, "2^39 + 1 bucket", Histogram::bucketOf(large), Histogram::BUCKETS - 2);
+
+    // the last bucket is the one just under 2^MAX_BITS, and anything bigger goes in it
+    const unsigned long long limit = 1ULL << Histogram::MAX_BITS;
+    failures += check(Histogram::bucketOf(limit - 1) == Histogram::BUCKETS - 1, "2^40 - 1 bucket", Histogram::bucketOf(limit - 1), Histogram::BUCKETS - 1);
+    Histogram clamped;
+    clamped.record(limit * 4);
+    double last = clamped.percentile(50);
+    failures += check(last < double(limit) && last > double(limit) * 31 / 32, "2^42", last, double(limit));
+
+    // negative values count as 0, and an empty histogram reports 0
+    Histogram negative;
+    negative.record(-5);
+    failures += check(negative.percentile(50) == 0, "-5", negative.percentile(50), 0);
+    failures += check(Histogram().percentile(99) == 0, "empty", Histogram().percentile(99), 0);
+
+    printf("%s\n", failures ? "histogram checks failed" : "histogram checks passed");
+    return failures ? 1 : 0;
+}
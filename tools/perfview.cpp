@@ -0,0 +1,163 @@
+// Shows rolling per-tag stats from a process streaming with startPerformanceStream.
+// usage: perfview [socket path] [window frames]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../PerfStream.h"
+
+using namespace std;
+
+struct TagWindow {
+    string name;
+    vector<uint32_t> calls; // per frame, a ring the size of the window
+    vector<int64_t> ticks;
+};
+
+int window = 120;
+int64_t frequency = 1;
+uint64_t framesSeen = 0; // total, so frame % window is the slot
+uint64_t framesDropped = 0;
+int64_t windowTicks[4096];
+vector<TagWindow> tags;
+
+static TagWindow &tagAt(int tag) {
+    if (tag >= int(tags.size())) tags.resize(tag + 1);
+    TagWindow &data = tags[tag];
+    if (data.calls.empty()) {
+        data.calls.assign(window, 0);
+        data.ticks.assign(window, 0);
+    }
+    return data;
+}
+
+static void readNames(const char *packet, size_t size, int count) {
+    size_t offset = sizeof(PerfStreamHeader);
+    for (int c = 0; c < count && offset + sizeof(PerfStreamName) <= size; c++) {
+        PerfStreamName name;
+        memcpy(&name, packet + offset, sizeof(name));
+        offset += sizeof(name);
+        if (offset + name.length > size) break;
+        tagAt(name.tag).name.assign(packet + offset, name.length);
+        offset += name.length;
+    }
+}
+
+static void readFrame(const char *packet, size_t size, int count) {
+    PerfStreamFrame frame;
+    if (size < sizeof(PerfStreamHeader) + sizeof(frame)) return;
+    memcpy(&frame, packet + sizeof(PerfStreamHeader), sizeof(frame));
+    frequency = frame.frequency;
+    framesDropped += frame.dropped;
+
+    int slot = int(framesSeen % window);
+    for (TagWindow &data : tags) {
+        if (data.calls.empty()) continue;
+        data.calls[slot] = 0;
+        data.ticks[slot] = 0;
+    }
+    windowTicks[slot] = frame.duration;
+
+    size_t offset = sizeof(PerfStreamHeader) + sizeof(frame);
+    for (int c = 0; c < count && offset + sizeof(PerfStreamTag) <= size; c++) {
+        PerfStreamTag tag;
+        memcpy(&tag, packet + offset, sizeof(tag));
+        offset += sizeof(tag);
+        TagWindow &data = tagAt(tag.tag);
+        data.calls[slot] = tag.calls;
+        data.ticks[slot] = tag.ticks;
+    }
+    framesSeen++;
+}
+
+static void printWindow() {
+    int frames = int(min<uint64_t>(framesSeen, window));
+    printf("\033[H\033[2J"); // clear the terminal
+    if (frames == 0) {
+        printf("Waiting for frames...\n");
+        fflush(stdout);
+        return;
+    }
+
+    int64_t total = 0;
+    for (int c = 0; c < frames; c++) total += windowTicks[c];
+    double frameMs = double(total) * 1000 / frequency / frames;
+    printf("%llu frames, %llu dropped, last %d: %.3fmS/frame (%.1f fps)\n\n",
+           (unsigned long long) framesSeen, (unsigned long long) framesDropped, frames,
+           frameMs, frameMs > 0 ? 1000 / frameMs : 0.0);
+    printf("CALLS_FRAME   AVG_FRAME   MAX_FRAME    AVG_CALL  TAG\n");
+    for (const TagWindow &data : tags) {
+        if (data.calls.empty()) continue;
+        uint64_t calls = 0;
+        int64_t ticks = 0, worst = 0;
+        for (int c = 0; c < frames; c++) {
+            calls += data.calls[c];
+            ticks += data.ticks[c];
+            worst = max(worst, data.ticks[c]);
+        }
+        if (calls == 0) continue;
+        printf("%11.2f  %8.1fuS  %8.1fuS  %8.3fuS  %s\n",
+               double(calls) / frames,
+               double(ticks) * 1e6 / frequency / frames,
+               double(worst) * 1e6 / frequency,
+               double(ticks) * 1e6 / frequency / calls,
+               data.name.empty() ? "?" : data.name.c_str());
+    }
+    fflush(stdout);
+}
+
+static double now() {
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : PERF_STREAM_DEFAULT_PATH;
+    if (argc > 2) window = max(1, min(atoi(argv[2]), int(sizeof(windowTicks) / sizeof(windowTicks[0]))));
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    if (fd < 0 || connect(fd, (sockaddr *) &address, sizeof(address)) < 0) {
+        printf("Failed to connect to %s (%s)\n", path, strerror(errno));
+        return 1;
+    }
+
+    static char packet[PERF_STREAM_MAX_PACKET];
+    double lastPrint = 0;
+    while (true) {
+        pollfd waiting = { fd, POLLIN, 0 };
+        if (poll(&waiting, 1, 250) > 0) {
+            ssize_t size = recv(fd, packet, sizeof(packet), 0);
+            if (size <= 0) {
+                printf("Stream closed\n");
+                return 0;
+            }
+            PerfStreamHeader header;
+            if (size_t(size) < sizeof(header)) continue;
+            memcpy(&header, packet, sizeof(header));
+            if (header.magic != PERF_STREAM_MAGIC) continue;
+            if (header.type == PERF_STREAM_NAMES) readNames(packet, size_t(size), header.count);
+            else if (header.type == PERF_STREAM_FRAME) readFrame(packet, size_t(size), header.count);
+        }
+
+        if (now() - lastPrint >= 1.0) {
+            printWindow();
+            lastPrint = now();
+        }
+    }
+}
@@ -0,0 +1,141 @@
+// Steps a scene through the broadphase and gjk with no window, then prints the Perf report and the pair counts.
+// For profiling captured scenes offline, under perf or anything else, and for comparing builds on the same scene.
+// usage: scenerun (scene-file | --generate bodies) [--seed n] [--steps n] [--dt seconds] [--write file]
+// --write saves the scene as it was before stepping, see scenefile.h for the format.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "gjk.h"
+#include "broadphase.h"
+#include "scenegen.h"
+#include "scenefile.h"
+#include "Perf.h"
+
+using namespace glm;
+using namespace std;
+
+struct CountStats {
+    double total = 0;
+    size_t min = SIZE_MAX;
+    size_t max = 0;
+
+    void add(size_t count) {
+        total += count;
+        min = std::min(min, count);
+        max = std::max(max, count);
+    }
+};
+
+static void usage() {
+    fprintf(stderr, "usage: scenerun (scene-file | --generate bodies) [--seed n] [--steps n] [--dt seconds] [--write file]\n");
+}
+
+int main(int argc, char **argv) {
+    const char *sceneFile = nullptr;
+    const char *writeFile = nullptr;
+    int generate = 0;
+    unsigned seed = 1;
+    int steps = 100;
+    float dt = 1.f / 60;
+
+    for (int c = 1; c < argc; c++) {
+        bool hasValue = c + 1 < argc;
+        if (!strcmp(argv[c], "--generate") && hasValue) {
+            generate = std::max(1, atoi(argv[++c]));
+        } else if (!strcmp(argv[c], "--seed") && hasValue) {
+            seed = unsigned(strtoul(argv[++c], nullptr, 10));
+        } else if (!strcmp(argv[c], "--steps") && hasValue) {
+            steps = std::max(0, atoi(argv[++c]));
+        } else if (!strcmp(argv[c], "--dt") && hasValue) {
+            dt = float(atof(argv[++c]));
+        } else if (!strcmp(argv[c], "--write") && hasValue) {
+            writeFile = argv[++c];
+        } else if (argv[c][0] != '-' && !sceneFile) {
+            sceneFile = argv[c];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (!sceneFile == !generate) {
+        usage();
+        return 2;
+    }
+
+    Scene scene;
+    if (sceneFile) {
+        string error;
+        if (!readScene(sceneFile, scene, &error)) {
+            fprintf(stderr, "%s: %s\n", sceneFile, error.c_str());
+            return 1;
+        }
+        printf("Read %d bodies from %s\n", int(scene.bodies.size()), sceneFile);
+    } else {
+        SceneSettings settings;
+        settings.seed = seed;
+        settings.bodies = generate;
+        settings.motion = MOTION_DRIFT; // what it would do read back from --write
+        generateScene(settings, scene);
+        printf("Generated %d bodies with seed %u\n", int(scene.bodies.size()), seed);
+    }
+    if (writeFile && !writeScene(writeFile, scene)) {
+        fprintf(stderr, "Couldn't write %s\n", writeFile);
+        return 1;
+    }
+
+    initPerformanceData();
+
+    vector<Aabb> boxes(scene.bodies.size());
+    vector<pair<int, int>> pairs;
+    SweepAndPrune sap;
+    CountStats pairCounts, contactCounts;
+
+    static PerfTag stepTag("Step");
+    static PerfTag moveTag("Move");
+    static PerfTag aabbTag("AABB");
+    static PerfTag narrowphaseTag("Narrowphase");
+
+    auto start = chrono::steady_clock::now();
+    for (int c = 0; c < steps; c++) {
+        size_t contacts = 0;
+        {
+            Perf stat(stepTag);
+            if (c > 0) {
+                // the first step is the scene as it was read
+                Perf move(moveTag);
+                scene.step(dt);
+            }
+            {
+                Perf aabb(aabbTag);
+                for (size_t d = 0; d < boxes.size(); d++) {
+                    boxes[d] = findAabb(scene.bodies[d].collider);
+                }
+            }
+            sap.findPairs(boxes, pairs);
+            {
+                Perf narrowphase(narrowphaseTag);
+                for (const pair<int, int> &pair : pairs) {
+                    contacts += collides(scene.bodies[pair.first].collider, scene.bodies[pair.second].collider);
+                }
+            }
+        }
+        markPerformanceFrame();
+        pairCounts.add(pairs.size());
+        contactCounts.add(contacts);
+    }
+    double elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    printPerformanceData();
+    printf("%d steps of %gs in %.3f mS, %.4f mS per step\n", steps, dt, elapsed, steps ? elapsed / steps : 0.0);
+    if (steps > 0) {
+        printf("pairs per step:    mean %12.1f  min %10zu  max %10zu\n", pairCounts.total / steps, pairCounts.min, pairCounts.max);
+        printf("contacts per step: mean %12.1f  min %10zu  max %10zu\n", contactCounts.total / steps, contactCounts.min, contactCounts.max);
+    }
+    return 0;
+}